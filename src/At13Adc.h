@@ -12,7 +12,65 @@
 
     ** Hay 2 versiones de funciones, para 8 o para 10 bits de resolucion **
 
-    -Solo usa 60 bytes.
+    Lectura de fondo (si se define ADC_FONDO_PERFILES antes del include):
+        #define ADC_FONDO_PERFILES {ADC_RAPIDO(0), ADC_PRECISO(3) | ADC_1V1}
+        adc_fondo_iniciar() deja al ADC convirtiendo solo, dando vueltas por los canales
+        de la lista con la INT ADC_vect (en ese orden; el mismo ADCn puede estar mas de
+        una vez con otro perfil). Cada canal tiene su perfil (ADMUX + prescaler, la tabla
+        queda en flash) y la INT cambia de perfil sola en cada conversion:
+            ADC_RAPIDO(n)   ADCn a 8 bits (ADLAR, se lee ADCH), clock/32
+            ADC_PRECISO(n)  ADCn a 10 bits, clock/128
+            ADC_1V1         (sumado a un perfil) Vref = 1.1V interna en vez de Vcc:
+                            ~1.07mV por cuenta, el ruido de Vcc no entra en la lectura
+        Cuando de un canal al otro cambia la Vref, la primera conversion se tira (el datasheet
+        dice que puede salir mal) y se repite el mismo canal: esa conversion de mas es el
+        tiempo de asentamiento de la referencia (173us a /128, el bandgap arranca en ~70us).
+        adc_fondo_leer(i) devuelve la ultima lectura del canal i de la lista, siempre en escala
+        de 10 bits (las de 8 bits van corridas 2 lugares: pasos de a 4 cuentas).
+        ADC_FONDO_VIGIA(canal, valor), si esta definida, se llama desde la INT
+        con cada lectura nueva (para cortes de seguridad que no pueden esperar al main).
+        Mientras corre no se pueden usar adc_setup_x / adc_read_x.
+        adc_fondo_parar() apaga el ADC (para dormir), despues se vuelve a largar con adc_fondo_iniciar().
+        adc_fondo_nueva(i) dice si el canal i ya tiene una lectura desde el ultimo
+        adc_fondo_iniciar() (antes adc_fondo_leer() da la de antes de parar, o 0 al arrancar).
+
+        Las conversiones no arrancan cuando termina la anterior sino con el disparo
+        automatico del ADC en el compare A del Timer0 (ADATE, ADTS = 011): el hardware
+        las larga justo en un TOP, sin la demora de ninguna INT. La INT del Timer0 las
+        arma con adc_fondo_disparo() un periodo antes, y no las arma si en ese TOP sube
+        el pulso del servo o si el pulso esta alto (ver At13Timer0.h). Asi cada lectura
+        sale en un instante fijo, multiplo exacto del periodo del timer, y lejos de los
+        flancos del servo. Cada conversion ocupa 2 periodos (RAPIDO) o 4 (PRECISO).
+
+    Perfiles a 9.6 MHz (13 ciclos del ADC por conversion; tiempos calculados, ruido
+    segun el datasheet y la nota AVR120):
+        perfil      clock ADC   conversion   paso (escala 10 bits)   error esperado
+        RAPIDO      300 kHz     43us         4 cuentas (~20mV)       +-1 LSB de 8 bits
+        PRECISO     75 kHz      173us        1 cuenta (~5mV)         +-2 LSB de 10 bits
+      Arriba de 200 kHz el ADC pierde los 2 bits de abajo, por eso el rapido es de 8.
+      Con el disparo del Timer0 (periodos de 80us, sin tono) un RAPIDO ocupa 160us y un
+      PRECISO 320us; si cambia la Vref se suma la conversion tirada.
+      Conviene ordenar la lista para cambiar de Vref lo menos posible.
+      Con el reloj en 1.2 MHz (reloj lento de At13Timer0.h) el mismo prescaler dejaria al
+      PRECISO en 9.4 kHz, fuera de los 50-200 kHz del datasheet, y los +-2 LSB no valdrian.
+      Por eso la INT del Timer0 avisa con adc_fondo_reloj() y el prescaler baja 8 veces
+      (/128 -> /16, /32 -> /4): el clock del ADC, los tiempos y el error quedan como arriba.
+      Los perfiles tienen que usar /8 o mas para poder bajarlos.
+
+    Mediana de 3 (si se define ADC_FONDO_MEDIANA): cada lectura que se guarda en
+    adc_fondo es la mediana de las ultimas 3 de ese canal, asi un pico suelto no pasa.
+    Es una red de ordenamiento de 3 comparaciones de 16 bits, sin lazos ni tablas.
+    Costo (estimado contando instrucciones, avr-gcc -Os): ~50 ciclos por conversion
+    (5us a 9.6 MHz) con la historia, ~1% de la CPU; Ram: 4 bytes por canal.
+    Una mediana de 5 rechazaria 2 picos seguidos pero son 7 comparaciones (~120 ciclos)
+    y 8 bytes por canal, demasiada Ram para el AtTiny13.
+    ADC_FONDO_VIGIA sigue recibiendo la lectura cruda (el corte no espera a la mediana).
+    La primera lectura de cada canal despues de adc_fondo_iniciar() llena toda la historia,
+    asi no quedan ceros del arranque ni lecturas de antes de dormir en la mediana.
+      Con el reloj en 1.2 MHz todo tarda 8 veces mas.
+
+    -Las funciones de lectura directa (adc_setup_x / adc_read_x) solo usan 60 bytes;
+     la lectura de fondo suma la INT, la tabla de perfiles y la mediana.
 
     Javier.
 */
@@ -22,6 +80,7 @@
 
 #include <Arduino.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
 
 void adc_setup_10(uint8_t bit)
 {
@@ -73,4 +132,141 @@ uint16_t adc_read_10()
     return ADC;
 }
 
-#endif
\ No newline at end of file
+#ifdef ADC_FONDO_PERFILES
+#include <avr/pgmspace.h>
+
+// perfil: bits de ADMUX (canal, ADLAR, REFS0) y el prescaler en los bits 2..4, que en ADMUX no se usan
+#define ADC_PERFIL(canal, ps) ((canal) | ((ps) << 2))
+#define ADC_RAPIDO(canal) (ADC_PERFIL(canal, 5) | (1 << ADLAR)) // 8 bits, clock/32
+#define ADC_PRECISO(canal) ADC_PERFIL(canal, 7)                 // 10 bits, clock/128
+#define ADC_1V1 (1 << REFS0)                                    // Vref interna de 1.1V
+#define ADC_PERFIL_PS (7 << 2)
+
+const uint8_t adc_fondo_perfil[] PROGMEM = ADC_FONDO_PERFILES;
+#define ADC_FONDO_CANALES sizeof(adc_fondo_perfil)
+
+volatile uint16_t adc_fondo[ADC_FONDO_CANALES]; // ultima lectura de cada canal (escala de 10 bits)
+uint8_t adc_fondo_canal;                        // el que se esta convirtiendo
+#ifdef ADC_FONDO_MEDIANA
+uint16_t adc_fondo_crudo[ADC_FONDO_CANALES][2]; // las 2 lecturas crudas anteriores de cada canal
+
+// mediana de 3: max(a, min(b, c)) con a <= b
+uint16_t mediana3(uint16_t a, uint16_t b, uint16_t c)
+{
+    if (a > b)
+    {
+        const uint16_t t = a;
+        a = b;
+        b = t;
+    }
+    if (b > c)
+        b = c;
+    return a > b ? a : b;
+}
+#endif
+volatile uint8_t adc_fondo_listo;               // 1 = canal elegido, falta el disparo
+volatile uint8_t adc_fondo_viejos;              // 1 bit por canal (hasta 8): sin lectura desde adc_fondo_iniciar()
+uint8_t adc_fondo_lento;                        // 1 = reloj en 1.2 MHz, prescaler 8 veces mas chico
+
+#define adc_fondo_nueva(canal) (!(adc_fondo_viejos & (1 << (canal))))
+
+// deja listo el canal c con su perfil, arranca con el proximo disparo
+void adc_fondo_convertir(uint8_t c)
+{
+    const uint8_t p = pgm_read_byte(&adc_fondo_perfil[c]);
+    ADMUX = p & ~ADC_PERFIL_PS;
+    uint8_t ps = (p & ADC_PERFIL_PS) >> 2;
+    if (adc_fondo_lento)
+        ps -= 3; // /8 del prescaler contra el /8 del reloj
+    // INT al terminar, sin ADATE; ADIF en 1 la borra, por si quedo una vieja de antes de adc_fondo_parar
+    ADCSRA = (1 << ADEN) | (1 << ADIE) | (1 << ADIF) | ps;
+    adc_fondo_listo = 1;
+}
+
+void adc_fondo_iniciar()
+{
+    ADCSRB = (1 << ADTS1) | (1 << ADTS0); // disparo: Timer0 compare A
+    adc_fondo_canal = 0;
+    adc_fondo_viejos = (1 << ADC_FONDO_CANALES) - 1;
+    adc_fondo_convertir(0);
+}
+
+// desde la INT del Timer0, despues de cada TOP: 1 = el proximo TOP puede largar una conversion.
+// ADIF se escribe en 0 para no borrar una INT del ADC que este esperando.
+// inline: una llamada desde la INT obliga a guardar todos los registros que pisa cualquier funcion.
+static inline void adc_fondo_disparo(uint8_t libre)
+{
+    if (libre && adc_fondo_listo)
+    {
+        adc_fondo_listo = 0;
+        ADCSRA = (ADCSRA & ~(1 << ADIF)) | (1 << ADATE);
+    }
+    else
+        ADCSRA &= ~((1 << ADIF) | (1 << ADATE)); // la que ya arranco sigue
+}
+
+// desde la INT del Timer0 cuando cambia el reloj (1 = baja a 1.2 MHz). Si la proxima conversion
+// todavia no arranco se le corrige el prescaler ya; la que esta en curso termina con el clock
+// cambiado a mitad de camino, y esa lectura suelta la saca la mediana.
+static inline void adc_fondo_reloj(uint8_t lento)
+{
+    adc_fondo_lento = lento;
+    if (adc_fondo_listo)
+    {
+        const uint8_t a = ADCSRA & ~(1 << ADIF);
+        ADCSRA = lento ? a - 3 : a + 3; // ADPS son los 3 bits de abajo y nunca pasan de 7
+    }
+}
+
+void adc_fondo_parar()
+{
+    ADCSRA = 0; // corta la conversion que estaba en curso
+}
+
+uint16_t adc_fondo_leer(uint8_t canal)
+{
+    const uint8_t sreg = SREG; // la INT no puede cambiarlo a medias
+    cli();
+    const uint16_t v = adc_fondo[canal];
+    SREG = sreg;
+    return v;
+}
+
+ISR(ADC_vect)
+{
+    static uint8_t asentando; // 1 = la conversion que termino fue la primera con otra Vref
+    const uint8_t c = adc_fondo_canal;
+    if (asentando)
+    {
+        asentando = 0;
+        adc_fondo_convertir(c); // se tira y va de nuevo, ya con la referencia quieta
+        return;
+    }
+    const uint8_t p = pgm_read_byte(&adc_fondo_perfil[c]);
+    const uint16_t v = (p & (1 << ADLAR)) ? ADCH << 2 : ADC;
+    // el canal siguiente ya, asi el vigia no atrasa el proximo disparo
+    uint8_t n = c + 1;
+    if (n == ADC_FONDO_CANALES)
+        n = 0;
+    adc_fondo_canal = n;
+    asentando = (p ^ pgm_read_byte(&adc_fondo_perfil[n])) & ADC_1V1;
+    adc_fondo_convertir(n);
+    const uint8_t bit = 1 << c;
+#ifdef ADC_FONDO_MEDIANA
+    uint16_t *h = adc_fondo_crudo[c];
+    if (adc_fondo_viejos & bit)
+        h[0] = h[1] = v; // la primera desde adc_fondo_iniciar() llena la historia
+    adc_fondo[c] = mediana3(h[0], h[1], v);
+    h[0] = h[1];
+    h[1] = v;
+#else
+    adc_fondo[c] = v;
+#endif
+    adc_fondo_viejos &= ~bit;
+#ifdef ADC_FONDO_VIGIA
+    ADC_FONDO_VIGIA(c, v);
+#endif
+}
+#endif
+
+#endif
@@ -0,0 +1,209 @@
+/*
+    Clasificador de la entrada compartida sensor de agua / pulsador (un solo pin ADC).
+
+        lectura ADC (10 bits)                  estado
+        < base + AGUA_SOBRE_BASE                0  nada    (Vcc/2)
+        entre los dos                          -1  agua    (aprox 3/4 Vcc)
+        > base + BOTON_SOBRE_BASE               1  boton   (Vcc)
+
+    La base es el nivel de "nada", que se corre con la tension y con la suciedad
+    del sensor: se aprende sola mientras no hay agua ni boton con un filtro lento
+    (promedio exponencial de 64 muestras, ~1.3s de constante de tiempo) y se
+    guarda en la EEPROM, asi al arrancar ya se clasifica bien desde la primera muestra.
+        - agua_iniciar(): lee la base de la EEPROM (512 si esta borrada o fuera de rango).
+        - agua_guardar(): la escribe si se corrio mas de AGUA_BASE_GUARDAR cuentas
+          (llamarla poco: al empezar a calentar, no en cada frame. Bloquea ~7ms).
+      La base queda entre AGUA_BASE_MIN y AGUA_BASE_MAX, asi un sensor mojado no la arrastra.
+
+    Dos filtros para que el ruido de la electrolisis y las burbujas cerca de los
+    umbrales no hagan titilar el estado:
+
+    - histeresis por estado: para salir del estado actual la lectura tiene que pasar
+      el umbral por AGUA_HISTERESIS cuentas (los umbrales se corren para afuera del
+      estado en el que se esta).
+    - votacion N de M: cada muestra ya clasificada vota, y el estado cambia solo si
+      una clase tiene AGUA_VOTOS_N votos entre las ultimas AGUA_VOTOS_M muestras.
+
+    Se le pasa una muestra por frame (20ms) con agua_muestra(), el estado queda en agua_estado.
+
+    Latencia de "sensor afuera" (agua -> nada), calculada en frames:
+        - mejor caso: AGUA_VOTOS_N muestras              -> 3 x 20ms = 60ms
+        - peor caso: + 1 frame hasta la primera muestra  -> 80ms
+          (+ lo que tarde el loop en llamar a tareas(), en controlar_temperatura()
+          es una lectura del LM35, menos de 1ms)
+      Una muestra suelta en la banda de histeresis o con la otra clase no la
+      alarga mientras se junten N votos de "nada" entre las M ultimas.
+      Sin agua el sensor queda en la base, lejos de base + AGUA_SOBRE_BASE - AGUA_HISTERESIS.
+
+    Corte rapido (vigia): la votacion es lenta a proposito, asi que el rele no
+    puede depender de ella ni del loop del main. Con la lectura de fondo del ADC
+    (ver ADC_FONDO_PERFILES en At13Adc.h) la INT le pasa cada lectura del sensor a agua_vigia():
+    si esta armada (agua_vigia_armar()) y AGUA_CORTE_MUESTRAS lecturas seguidas quedan
+    cerca de la base (abajo de base + AGUA_SOBRE_BASE / 2), apaga AGUA_CORTE_PIN en
+    PORTB ahi mismo y deja agua_cortado en 1.
+        - una lectura del sensor cada 1.28ms (vuelta de 16 periodos de 80us con las
+          2 lecturas del LM35 y el disparo del Timer0, ver At13Adc.h)
+          -> corte en 2 x 1.28ms = ~2.6ms, pase lo que pase en el main; hasta ~5.4ms
+          si el servo se esta moviendo (mientras el pulso esta alto no se convierte)
+        - la mitad del umbral y las 2 lecturas seguidas: una burbuja suelta no corta.
+
+    Ram: 8 bytes. EEPROM: 2 bytes.
+*/
+
+#ifndef attiny13_agua_h
+#define attiny13_agua_h
+
+#include <inttypes.h>
+#include <avr/eeprom.h>
+
+// umbrales sobre la base (con la base en 512 quedan en 650 y 900)
+#ifndef AGUA_SOBRE_BASE
+#define AGUA_SOBRE_BASE 138
+#endif
+#ifndef BOTON_SOBRE_BASE
+#define BOTON_SOBRE_BASE 388
+#endif
+#ifndef AGUA_BASE_MIN
+#define AGUA_BASE_MIN 448
+#endif
+#ifndef AGUA_BASE_MAX
+#define AGUA_BASE_MAX 576
+#endif
+#ifndef AGUA_BASE_GUARDAR
+#define AGUA_BASE_GUARDAR 4 // cuentas que se tiene que correr la base para volver a grabarla
+#endif
+#ifndef AGUA_CORTE_MUESTRAS
+#define AGUA_CORTE_MUESTRAS 2 // lecturas seguidas afuera del agua para que la vigia corte
+#endif
+#ifndef AGUA_HISTERESIS
+#define AGUA_HISTERESIS 24 // cuentas del ADC a cada lado del umbral
+#endif
+#ifndef AGUA_VOTOS_M
+#define AGUA_VOTOS_M 5 // muestras que se miran (hasta 8)
+#endif
+#ifndef AGUA_VOTOS_N
+#define AGUA_VOTOS_N 3 // votos para cambiar de estado (mas de la mitad de M)
+#endif
+
+#if AGUA_VOTOS_M > 8 || AGUA_VOTOS_N * 2 <= AGUA_VOTOS_M
+#error "AGUA_VOTOS_M tiene que ser <= 8 y AGUA_VOTOS_N mas de la mitad"
+#endif
+
+int8_t agua_estado;    // 0 = nada, -1 = agua, 1 = boton
+uint8_t agua_votos;    // 1 bit por muestra (la mas nueva abajo): fue agua
+uint8_t boton_votos;   // idem: fue boton (ninguno de los dos = nada)
+uint16_t agua_base64;  // base x 64 (1023 x 64 entra justo en 16 bits)
+uint16_t EEMEM agua_base_ee;
+
+#define agua_base() (agua_base64 >> 6)
+
+void agua_iniciar()
+{
+    uint16_t b = eeprom_read_word(&agua_base_ee);
+    if (b < AGUA_BASE_MIN || b > AGUA_BASE_MAX) // 0xffff = EEPROM borrada
+        b = 512;
+    agua_base64 = b << 6;
+}
+
+void agua_guardar()
+{
+    const uint16_t b = agua_base(), e = eeprom_read_word(&agua_base_ee);
+    if (b > e + AGUA_BASE_GUARDAR || b + AGUA_BASE_GUARDAR < e)
+        eeprom_update_word(&agua_base_ee, b);
+}
+
+// cuenta los votos de las ultimas AGUA_VOTOS_M muestras
+uint8_t agua_contar(uint8_t v)
+{
+    uint8_t n = 0;
+    v &= (1 << AGUA_VOTOS_M) - 1;
+    while (v)
+    {
+        v &= v - 1;
+        n++;
+    }
+    return n;
+}
+
+// una vez por frame, con la lectura del ADC de 10 bits
+void agua_muestra(uint16_t t)
+{
+    // umbrales corridos para afuera del estado actual
+    const uint16_t base = agua_base();
+    uint16_t nada = base + AGUA_SOBRE_BASE, boton = base + BOTON_SOBRE_BASE;
+    if (agua_estado == 0)
+        nada += AGUA_HISTERESIS;
+    else if (agua_estado == 1)
+        boton -= AGUA_HISTERESIS;
+    else
+    {
+        nada -= AGUA_HISTERESIS;
+        boton += AGUA_HISTERESIS;
+    }
+
+    agua_votos <<= 1;
+    boton_votos <<= 1;
+    if (t > boton)
+        boton_votos |= 1;
+    else if (t >= nada)
+        agua_votos |= 1;
+    else if (agua_estado == 0)
+    {
+        // base += (t - base) / 64, sin salir del rango
+        agua_base64 += t - base;
+        if (agua_base64 < AGUA_BASE_MIN * 64U)
+            agua_base64 = AGUA_BASE_MIN * 64U;
+        else if (agua_base64 > AGUA_BASE_MAX * 64U)
+            agua_base64 = AGUA_BASE_MAX * 64U;
+    }
+
+    const uint8_t a = agua_contar(agua_votos), p = agua_contar(boton_votos);
+    if (a >= AGUA_VOTOS_N)
+        agua_estado = -1;
+    else if (p >= AGUA_VOTOS_N)
+        agua_estado = 1;
+    else if (AGUA_VOTOS_M - a - p >= AGUA_VOTOS_N)
+        agua_estado = 0;
+}
+
+#ifdef AGUA_CORTE_PIN
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+uint16_t agua_corte;           // debajo de esto el sensor esta afuera (0 = vigia desarmada)
+uint8_t agua_corte_n;          // lecturas seguidas debajo de agua_corte
+volatile uint8_t agua_cortado; // 1 = la vigia apago AGUA_CORTE_PIN
+
+// arma la vigia con la base actual (llamarla con AGUA_CORTE_PIN ya prendido)
+void agua_vigia_armar()
+{
+    const uint16_t corte = agua_base() + AGUA_SOBRE_BASE / 2;
+    cli();
+    agua_corte = corte;
+    agua_corte_n = 0;
+    agua_cortado = 0;
+    sei();
+}
+
+void agua_vigia_desarmar()
+{
+    cli();
+    agua_corte = 0;
+    sei();
+}
+
+// desde la INT del ADC, con cada lectura del sensor
+void agua_vigia(uint16_t t)
+{
+    if (t >= agua_corte) // tambien si esta desarmada
+        agua_corte_n = 0;
+    else if (++agua_corte_n >= AGUA_CORTE_MUESTRAS)
+    {
+        PORTB &= ~AGUA_CORTE_PIN;
+        agua_cortado = 1;
+        agua_corte = 0;
+    }
+}
+#endif
+
+#endif
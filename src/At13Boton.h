@@ -0,0 +1,120 @@
+/*
+    Eventos de un pulsador: apretada corta, larga y doble.
+
+    No usa delays ni timers propios: se le pasa el estado del pulsador una vez
+    por frame (20ms) con boton_muestra() y los tiempos salen de contar muestras.
+    Los eventos quedan en una cola de 4 (2 bits c/u) y se sacan con boton_evento().
+
+        corto  -> se solto antes de BOTON_FRAMES_LARGO y no hubo otra apretada en BOTON_FRAMES_DOBLE
+        doble  -> dos apretadas cortas separadas por menos de BOTON_FRAMES_DOBLE
+        largo  -> sigue apretado despues de BOTON_FRAMES_LARGO (sale sin esperar a soltarlo)
+
+    Ram: 6 bytes.
+*/
+
+#ifndef attiny13_boton_h
+#define attiny13_boton_h
+
+#include <inttypes.h>
+
+// todos en frames de 20ms
+#ifndef BOTON_FRAMES_REBOTE
+#define BOTON_FRAMES_REBOTE 2 // muestras iguales para aceptar un cambio (40ms)
+#endif
+#ifndef BOTON_FRAMES_LARGO
+#define BOTON_FRAMES_LARGO 50 // 1 segundo
+#endif
+#ifndef BOTON_FRAMES_DOBLE
+#define BOTON_FRAMES_DOBLE 15 // 300ms entre soltar y volver a apretar
+#endif
+
+enum
+{
+    BOTON_NADA,
+    BOTON_CORTO,
+    BOTON_LARGO,
+    BOTON_DOBLE
+};
+
+// bits de boton_estado
+#define BOTON_APRETADO 1  // estado ya sin rebote
+#define BOTON_PENDIENTE 2 // hubo un click corto, esperando a ver si es doble
+#define BOTON_YA_LARGO 4  // ya se aviso el largo de esta apretada
+
+uint8_t boton_estado;
+uint8_t boton_rebote; // muestras seguidas distintas del estado
+uint8_t boton_frames; // frames desde el ultimo cambio (hasta 255)
+uint8_t boton_cola;   // eventos de 2 bits, el mas viejo abajo
+uint8_t boton_n;      // eventos en la cola
+
+void boton_encolar(uint8_t ev)
+{
+    if (boton_n < 4)
+        boton_cola |= ev << (boton_n++ << 1);
+}
+
+// saca el evento mas viejo (BOTON_NADA si no hay)
+uint8_t boton_evento()
+{
+    if (!boton_n)
+        return BOTON_NADA;
+    const uint8_t ev = boton_cola & 3;
+    boton_cola >>= 2;
+    boton_n--;
+    return ev;
+}
+
+// descarta los eventos que quedaron en la cola (los que llegaron mientras nadie los leia)
+void boton_vaciar()
+{
+    boton_n = 0;
+    boton_cola = 0;
+}
+
+// una vez por frame, con 1 si el pulsador esta apretado
+void boton_muestra(uint8_t apretado)
+{
+    if (boton_frames < 255)
+        boton_frames++;
+
+    if (!apretado != !(boton_estado & BOTON_APRETADO))
+    {
+        if (++boton_rebote >= BOTON_FRAMES_REBOTE)
+        {
+            boton_rebote = 0;
+            boton_frames = 0;
+            boton_estado ^= BOTON_APRETADO;
+            if (!(boton_estado & BOTON_APRETADO))
+            {
+                // se solto: si fue corto, es el primero o el segundo de un doble
+                if (!(boton_estado & BOTON_YA_LARGO))
+                {
+                    if (boton_estado & BOTON_PENDIENTE)
+                        boton_encolar(BOTON_DOBLE);
+                    boton_estado ^= BOTON_PENDIENTE;
+                }
+                boton_estado &= ~BOTON_YA_LARGO;
+            }
+        }
+    }
+    else
+        boton_rebote = 0;
+
+    if (boton_estado & BOTON_APRETADO)
+    {
+        if (!(boton_estado & BOTON_YA_LARGO) && boton_frames >= BOTON_FRAMES_LARGO)
+        {
+            if (boton_estado & BOTON_PENDIENTE)
+                boton_encolar(BOTON_CORTO); // el click de antes queda como corto
+            boton_encolar(BOTON_LARGO);
+            boton_estado = (boton_estado & ~BOTON_PENDIENTE) | BOTON_YA_LARGO;
+        }
+    }
+    else if ((boton_estado & BOTON_PENDIENTE) && boton_frames >= BOTON_FRAMES_DOBLE)
+    {
+        boton_estado &= ~BOTON_PENDIENTE;
+        boton_encolar(BOTON_CORTO);
+    }
+}
+
+#endif
@@ -0,0 +1,59 @@
+/*
+    Corrección gamma para el LED WS2812B
+
+    El ojo no ve lineal: de 0 a 255 casi todo el cambio se nota abajo y de la
+    mitad para arriba "parece" que no cambia nada. Esto aproxima y = x^2 / 255
+    con 4 rectas cuyas pendientes son potencias de 2 (1/4, 1/2, 1, 2), así que
+    solo usa shifts y restas, sin tabla ni multiplicaciones:
+
+          x     |  y
+        --------+---------------------
+          0- 63 |  x/4          0- 15
+         64-127 |  x/2 - 16    16- 47
+        128-175 |  x   - 80    48- 95
+        176-255 |  2x  - 256   96-254
+
+    Es continua en los cortes (no hay saltos en un fade) y 0 sigue siendo 0.
+
+    Todos los drivers pasan por aca:
+        - los que mandan el color de una (ws2812b_*): gamma_grb(r, g, b) devuelve
+          los 3 bytes ya corregidos en el orden del WS2812B.
+        - los que mandan byte por byte (LED_Out): gamma8() en cada byte.
+
+    Flash (estimado contando las instrucciones que saca avr-gcc -Os):
+        - gamma8(): 16 instrucciones, 32 bytes; cada llamada ~4 bytes mas.
+        - gamma_grb(): las 3 llamadas y el armado del resultado, ~30 bytes.
+        - una tabla de 256 bytes en PROGMEM costaría ~270 bytes, el 26% del flash.
+        - contra el driver compacto (LED_Out, 48 bytes) son ~36 bytes, un +75%;
+          contra el desenrollado (ws2812b_change_color, ~300 bytes) ~70, un +25%.
+*/
+
+#ifndef attiny13_gamma_h
+#define attiny13_gamma_h
+
+#include <inttypes.h>
+
+uint8_t gamma8(uint8_t x)
+{
+    if (x < 64)
+        return x >> 2;
+    if (x < 128)
+        return (x >> 1) - 16;
+    if (x < 176)
+        return x - 80;
+    return x << 1; // 2x - 256 (desborda a proposito)
+}
+
+// color ya corregido, en el orden en que lo recibe el WS2812B
+typedef struct
+{
+    uint8_t g, r, b;
+} gamma_grb_t;
+
+gamma_grb_t gamma_grb(uint8_t r, uint8_t g, uint8_t b)
+{
+    gamma_grb_t c = {gamma8(g), gamma8(r), gamma8(b)};
+    return c;
+}
+
+#endif
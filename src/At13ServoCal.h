@@ -0,0 +1,71 @@
+/*
+    Calibracion del servo: un solo modelo para todas las tablas.
+
+    Se definen los pulsos de los extremos (en us) y la cantidad de posiciones,
+    y al compilar se arman las tablas que hagan falta:
+
+        #define SERVO_POSICIONES 14             // (opcional, antes del include)
+        #include "At13ServoCal.h"
+
+        const uint16_t pulsos_us[] PROGMEM = SERVO_TABLA(SERVO_US);       // en us
+        const uint16_t pulsos[] PROGMEM = SERVO_TABLA(SERVO_TICKS);       // en ticks de 10us
+
+    En runtime queda una sola lectura de tabla: pgm_read_word(&pulsos[index]).
+    Para grados (0..180) estan SERVO_US_GRADOS() y SERVO_TICKS_GRADOS(), que reemplazan al map() de Arduino
+    (division de 32 bits) por una multiplicacion de 16 bits y un shift.
+
+    Valores por defecto: el micro-servo azul con el AtTiny13 a 9.6 MHz.
+*/
+
+#ifndef attiny13_servo_cal_h
+#define attiny13_servo_cal_h
+
+#include <avr/pgmspace.h>
+
+#ifndef SERVO_US_MIN
+#define SERVO_US_MIN 600 // pulso de la primera posicion (0°)
+#endif
+#ifndef SERVO_US_MAX
+#define SERVO_US_MAX 2730 // pulso de la ultima posicion (180°)
+#endif
+#ifndef SERVO_POSICIONES
+#define SERVO_POSICIONES 13 // cantidad de posiciones (2 a 16)
+#endif
+
+#if SERVO_POSICIONES < 2 || SERVO_POSICIONES > 16
+#error "SERVO_POSICIONES tiene que estar entre 2 y 16"
+#endif
+
+// pulso de la posicion i, en us y en ticks de 10us (redondeados, solo para constantes)
+#define SERVO_US(i) (SERVO_US_MIN + (((uint32_t)(i) * (SERVO_US_MAX - SERVO_US_MIN) + (SERVO_POSICIONES - 1) / 2) / (SERVO_POSICIONES - 1)))
+#define SERVO_TICKS(i) ((SERVO_US(i) + 5) / 10)
+
+// grados -> us: pendiente en punto fijo 12.4 (g * pendiente entra en 16 bits hasta 180°)
+#define SERVO_US_POR_GRADO_X16 (((SERVO_US_MAX - SERVO_US_MIN) * 16UL + 90) / 180)
+#define SERVO_US_GRADOS(g) (SERVO_US_MIN + (((uint16_t)(g) * (uint16_t)SERVO_US_POR_GRADO_X16) >> 4))
+// grados -> ticks de 10us: pendiente en 8.8 (g * pendiente entra en 16 bits hasta 180°)
+#define SERVO_TICKS_POR_GRADO_X256 (((SERVO_US_MAX - SERVO_US_MIN) * 256UL / 10 + 90) / 180)
+#define SERVO_TICKS_GRADOS(g) ((SERVO_US_MIN + 5) / 10 + (((uint16_t)(g) * (uint16_t)SERVO_TICKS_POR_GRADO_X256) >> 8))
+
+// {F(0), F(1), ... F(SERVO_POSICIONES - 1)}
+#define SERVO_REP_1(F) F(0)
+#define SERVO_REP_2(F) SERVO_REP_1(F), F(1)
+#define SERVO_REP_3(F) SERVO_REP_2(F), F(2)
+#define SERVO_REP_4(F) SERVO_REP_3(F), F(3)
+#define SERVO_REP_5(F) SERVO_REP_4(F), F(4)
+#define SERVO_REP_6(F) SERVO_REP_5(F), F(5)
+#define SERVO_REP_7(F) SERVO_REP_6(F), F(6)
+#define SERVO_REP_8(F) SERVO_REP_7(F), F(7)
+#define SERVO_REP_9(F) SERVO_REP_8(F), F(8)
+#define SERVO_REP_10(F) SERVO_REP_9(F), F(9)
+#define SERVO_REP_11(F) SERVO_REP_10(F), F(10)
+#define SERVO_REP_12(F) SERVO_REP_11(F), F(11)
+#define SERVO_REP_13(F) SERVO_REP_12(F), F(12)
+#define SERVO_REP_14(F) SERVO_REP_13(F), F(13)
+#define SERVO_REP_15(F) SERVO_REP_14(F), F(14)
+#define SERVO_REP_16(F) SERVO_REP_15(F), F(15)
+#define SERVO_REP_(n, F) SERVO_REP_##n(F)
+#define SERVO_REP(n, F) SERVO_REP_(n, F)
+#define SERVO_TABLA(F) {SERVO_REP(SERVO_POSICIONES, F)}
+
+#endif
@@ -0,0 +1,372 @@
+/*
+    Timer0 compartido: base de tiempo, servo y buzzer al mismo tiempo.
+
+    Datasheet:
+        https://ww1.microchip.com/downloads/en/devicedoc/doc2535.pdf
+
+    El AtTiny13 tiene un solo timer. Este archivo es el unico que toca TCCR0A,
+    TCCR0B, OCR0A, OCR0B y TIMSK0; el resto del programa usa:
+        timer0_init()       arranca todo (CTC, clock/8)
+        timer0_parar()      congela el timer para dormir, timer0_seguir() lo vuelve a largar
+        servo_pedir(ticks)  mueve el servo (ancho de pulso en ticks de 10us)
+        tono(k, frames)     suena f = 50 kHz / k durante frames de 20ms
+        reloj_lento_ok      1 = el main deja bajar el reloj a 1.2 MHz (ver abajo)
+        reloj_rafaga()      9.6 MHz un rato (con las INT cortadas), reloj_rafaga_fin() vuelve
+        Tick, Frames, DecSeg, UnSeg para medir tiempo.
+
+    Reloj lento: si el main lo permite, no hay tono y el servo esta en reposo, la INT
+    baja el reloj del sistema a 1.2 MHz (CLKPR /8). El Timer0 sigue en clock/8 (150 kHz)
+    y pasa a periodos de 1ms (TOP = 149, Tick += 100) para que la INT no se coma la CPU.
+    Apenas aparece un tono o un objetivo nuevo del servo, la INT vuelve a 9.6 MHz en el
+    periodo siguiente (1ms como mucho), antes del primer flanco.
+    El WS2812B necesita 9.6 MHz: reloj_rafaga() sube el reloj y pasa el Timer0 a clock/64,
+    que a 9.6 MHz sigue contando a 150 kHz, asi la rafaga no adelanta el tiempo.
+    Consumo (datasheet, figura de corriente activa vs frecuencia a 5V):
+    ~6mA a 9.6 MHz contra ~1.2mA a 1.2 MHz. Para verificarlo: amperimetro en la
+    alimentacion del micro, en idle con la aguja quieta, con reloj_lento_ok en 0 y en 1.
+    Con la lectura de fondo de At13Adc.h, cada cambio de reloj tambien baja o sube 8 veces
+    el prescaler del ADC (adc_fondo_reloj()): el ADC sigue en 75-300 kHz y las lecturas
+    PRECISO con el mismo error, asi lm35_ajuste puede aprender en idle con el reloj lento.
+    Cada conversion entra en un periodo de 1ms; al calentar el main no deja bajar el reloj.
+
+    Como se reparten los canales:
+        TOP (OCR0A)  -> la INT TIM0_COMPA = base de tiempo, y el tono en OC0A (PB0)
+                        con "toggle on compare" (sin tono: TOP = 95, 80us).
+        OCR0B        -> los dos flancos del servo en OC0B (PB1), sin INT.
+        Overflow     -> no se usa.
+        compare A    -> ademas dispara las conversiones del ADC de fondo (si se usa
+                        At13Adc.h con ADC_FONDO_PERFILES, incluido antes que este).
+
+    Presupuesto de ciclos de la INT (estimado contando instrucciones, 9.6 MHz):
+        entrada + salida (push/pop)          ~40 ciclos
+        cuenta de Tick, tono, flanco         ~45 ciclos
+        reloj lento (la condicion)           ~15 ciclos
+        armado del ADC (adc_fondo_disparo)   ~15 ciclos
+        cambio de reloj + prescaler ADC      ~20 ciclos mas, solo cuando cambia
+        cierre de frame (1 vez cada 20ms)    ~80 ciclos mas
+        -> sin tono, una INT cada 768 ciclos: ~15% de la CPU.
+        -> con tono k = 12 (la mas seguida), una cada 1152: ~10%.
+        -> con el reloj lento, una cada 1200 ciclos (1ms a 1.2 MHz): ~10%.
+        (antes, el tick de 100 kHz se comia casi la mitad de la CPU)
+      La INT no llama a ninguna funcion (adc_fondo_disparo() es inline y clock_prescale_set()
+      de <avr/power.h> tambien): una llamada haria guardar los ~12 registros que cualquier
+      funcion puede pisar, ~50 ciclos mas por INT.
+
+    Reglas para no romper los tiempos:
+        - el main nunca escribe registros del Timer0 directamente.
+        - con las INT cortadas no se puede estar mas de ~80us (el LED tarda 30us);
+          si la INT entra tarde el servo igual baja, pero el pulso sale mas largo.
+        - no se puede usar junto con At13Pwm.h ni con la clase Servo de At13Servo.h
+          (SERVO_CLASE): los tres definen TIMER0_DUENO y el compilador avisa.
+*/
+
+#ifndef attiny13_timer0_h
+#define attiny13_timer0_h
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/wdt.h>
+#include <avr/power.h>
+
+#if F_CPU != 9600000UL
+#error "Los tiempos del Timer0 estan calculados para F_CPU = 9600000UL"
+#endif
+
+#ifdef TIMER0_DUENO
+#error "El Timer0 ya lo usa otro archivo (ver TIMER0_DUENO)"
+#endif
+#define TIMER0_DUENO "At13Timer0.h"
+
+// velocidad de la aguja: ticks (10us) que se acerca el pulso al objetivo en cada frame de 20ms.
+// con 3, el recorrido completo (60 -> 273) tarda 1.4 segundos.
+#ifndef SERVO_PASO
+#define SERVO_PASO 3
+#endif
+
+// frames (20ms) que la aguja tiene que estar quieta para dejar de mandarle pulsos al servo.
+// sin pulsos el servo suelta el motor (no consume) y la INT no tiene que armar flancos.
+// se vuelve a enganchar solo cuando se pide otra posicion.
+#ifndef SERVO_REPOSO
+#define SERVO_REPOSO 50
+#endif
+
+// periodo del WDT dormido (WDTO_500MS a WDTO_8S de <avr/wdt.h>: tiene que ser un numero entero de frames)
+#ifndef WDT_DORMIDO
+#define WDT_DORMIDO WDTO_500MS
+#endif
+#if WDT_DORMIDO < WDTO_500MS
+#error "WDT_DORMIDO tiene que ser de 500ms o mas"
+#endif
+#define WDT_FRAMES (25U << (WDT_DORMIDO - WDTO_500MS))
+
+volatile uint16_t Tick;           // tiempo dentro del frame, en ticks de 10us (0..1999)
+uint16_t sPulse;                  // Servo pulse variable (solo la toca la INT, ver SERVO_PASO)
+uint16_t servo_objetivo;          // hacia donde va sPulse (solo la INT)
+volatile uint16_t servo_sombra;   // objetivo nuevo que escribe el main (ver servo_pedir)
+volatile uint8_t servo_listo;     // 1 = servo_sombra tiene un valor nuevo, la INT lo baja al tomarlo
+volatile uint8_t servo_quieto;    // frames que sPulse lleva en el objetivo (hasta SERVO_REPOSO)
+volatile uint8_t UnSeg;
+volatile uint8_t DecSeg;
+volatile uint8_t Frames;          // cuenta frames de 20ms (para las tareas de fondo)
+volatile uint8_t reloj_lento_ok;  // 1 = el main deja bajar el reloj (ver arriba)
+uint8_t reloj_lento;              // 1 = el sistema corre a 1.2 MHz (solo lo cambia la INT)
+
+// el main nunca escribe un valor de 16 bits que la INT pueda leer a medias:
+// escribe servo_sombra con servo_listo en 0 y la INT lo copia al empezar el frame.
+// (no hace falta cli/sei: la bandera es de 8 bits)
+void servo_pedir(uint16_t pulso)
+{
+    servo_listo = 0; // la INT no toca servo_sombra mientras lo escribo
+    servo_sombra = pulso;
+    servo_listo = 1;
+}
+
+// tonos del buzzer: el Timer0 hace toggle de OC0A (PB0) en cada TOP, sin INT por flanco.
+// con TOP = 12 * k - 1 (clock/8) el periodo del timer es de k ticks de 10us, asi
+// que el tiempo se sigue contando igual y el tono sale de f = 50 kHz / k.
+enum
+{
+    TONO_AGUDO = 12, // 4167 Hz
+    TONO_MEDIO = 16, // 3125 Hz
+    TONO_GRAVE = 21  // 2381 Hz (el TOP mas grande que entra en 8 bits)
+};
+
+volatile uint8_t tono_k;      // 0 = silencio
+volatile uint8_t tono_frames; // frames de 20ms que le quedan al tono
+
+// arranca un tono y vuelve enseguida, la INT lo corta solo.
+void tono(uint8_t k, uint8_t frames)
+{
+    tono_k = 0;
+    tono_frames = frames;
+    tono_k = k;
+}
+
+///// *** Esta INT de timer mueve el servo motor y hace sonar el buzzer ***
+///// Timer0 en CTC con clock/8 (1.2 MHz): sin tono, TOP = 95 -> una INT cada 80us.
+///// Tick cuenta de a 10us (60 ticks son .6ms, 273 ticks son 2.73ms) y avanza lo que
+///// dura cada periodo del timer (8 ticks, o k si hay un tono).
+///// Los dos flancos del pulso del servo los hace el hardware en OC0B (PB1):
+/////  - sube con "set on compare" en el TOP del periodo que cierra el frame,
+/////  - baja con "clear on compare" en OCR0B = (ticks que faltan) * 12 - 1,
+///// asi el ancho del pulso no depende del periodo del timer ni de cuando entra la INT.
+///// Si la bajada cae en los primeros 8 ticks de un periodo (OCR0B desde 11), la INT que
+///// abre ese periodo no llega a escribir OCR0B a tiempo despues de todo lo demas: ese
+///// valor lo calcula la INT anterior (ocr_bajada) y se escribe antes que nada.
+///// Frames avanza al pasar el tick 320, cuando ya termino el pulso del servo (max 273).
+ISR(TIM0_COMPA_vect)
+{
+    static uint8_t paso = 8;  // ticks que dura el periodo que acaba de terminar
+    static uint16_t fin;      // Tick en que baja el pulso del servo (0 = no hay pulso)
+    static uint8_t bajando;   // 1 = el periodo que termino tenia programada la bajada
+    static uint8_t marcado;   // 1 = ya se conto el Frame de este frame
+    static uint8_t ocr_bajada; // OCR0B de una bajada temprana en este periodo (0 = no hay)
+
+    // lo primero: con d = 1 el compare es a las 11 cuentas (~88 ciclos del TOP)
+    const uint8_t b = ocr_bajada;
+    if (b)
+        OCR0B = b;
+    ocr_bajada = 0;
+
+    Tick += paso;
+
+    // por si la INT entro tarde y el compare B ya habia pasado: fuerzo la bajada
+    // (si ya estaba bajo no hace nada)
+    if (bajando)
+        TCCR0B |= (1 << FOC0B);
+    bajando = b != 0;
+
+    // proximo periodo: con tono, sin tono o con el reloj lento
+    const uint8_t k = tono_k;
+    const uint8_t lento = reloj_lento_ok && !k && !fin && !bajando && !servo_listo && servo_quieto >= SERVO_REPOSO;
+    if (lento != reloj_lento)
+    {
+        reloj_lento = lento;
+        clock_prescale_set(lento ? clock_div_8 : clock_div_1);
+#ifdef ADC_FONDO_PERFILES
+        adc_fondo_reloj(lento);
+#endif
+    }
+    if (k)
+    {
+        paso = k;
+        OCR0A = (k << 3) + (k << 2) - 1;
+        TCCR0A |= (1 << COM0A0); // toggle OC0A
+    }
+    else if (lento)
+    {
+        paso = 100;
+        OCR0A = 149; // 150 kHz / 150 = 1ms
+        TCCR0A &= ~(1 << COM0A0);
+    }
+    else
+    {
+        paso = 8;
+        OCR0A = 95;
+        TCCR0A &= ~(1 << COM0A0); // PB0 vuelve a PORTB (apagado)
+    }
+
+    // el pulso del servo baja en este periodo (d > 8, con tono: OCR0B de 107 para arriba,
+    // hay tiempo) o en los primeros 8 ticks del siguiente (lo escribe la INT que viene)?
+    // (con el pulso alto no hay reloj lento: el siguiente dura 8 ticks o mas)
+    if (fin)
+    {
+        if (fin <= Tick + paso)
+        {
+            const uint8_t d = fin - Tick; // 9..paso
+            OCR0B = (d << 3) + (d << 2) - 1;
+            fin = 0;
+            bajando = 1;
+        }
+        else if (fin <= Tick + paso + 8)
+        {
+            const uint8_t d = fin - Tick - paso; // 1..8
+            ocr_bajada = (d << 3) + (d << 2) - 1;
+            fin = 0;
+        }
+    }
+
+    if (Tick >= 2000)
+    { // One servo frame (20ms) completed
+        Tick -= 2000;
+        marcado = 0;
+        if (++DecSeg >= 50)
+        {
+            DecSeg = 0;
+            UnSeg++; // un segundo completo
+        }
+
+        // objetivo nuevo? se toma solo aca, entre pulsos, y se avisa bajando servo_listo
+        if (servo_listo)
+        {
+            servo_objetivo = servo_sombra;
+            servo_listo = 0;
+        }
+
+        // el pulso no salta al objetivo: se acerca de a SERVO_PASO por frame,
+        // asi la aguja se mueve suave y el servo no tira un pico de corriente.
+        // reposo: si la aguja no se movio en SERVO_REPOSO frames, no se mandan pulsos.
+        uint16_t p = sPulse;
+        const uint16_t o = servo_objetivo;
+        if (p != o)
+        {
+            servo_quieto = 0;
+            if (p + SERVO_PASO < o)
+                p += SERVO_PASO;
+            else if (p > o + SERVO_PASO)
+                p -= SERVO_PASO;
+            else
+                p = o;
+            sPulse = p;
+        }
+        else if (servo_quieto < SERVO_REPOSO)
+            servo_quieto++;
+
+        // si el timer subio el pulso en este TOP, queda listo para bajarlo
+        if (TCCR0A & (1 << COM0B0))
+        {
+            OCR0B = 0xff; // nunca llega (TOP <= 251)
+            TCCR0A &= ~(1 << COM0B0); // clear OC0B on compare match
+            fin = Tick + sPulse;
+        }
+
+        if (tono_k && !--tono_frames)
+            tono_k = 0;
+    }
+    else if (Tick + paso >= 2000 && servo_quieto < SERVO_REPOSO)
+    {
+        // el proximo TOP cierra el frame: ahi sube el pulso del servo
+        OCR0B = OCR0A;
+        TCCR0A |= (1 << COM0B0); // set OC0B on compare match
+    }
+
+    if (Tick >= 320 && !marcado)
+    {
+        marcado = 1;
+        Frames++;
+    }
+
+#ifdef ADC_FONDO_PERFILES
+    // lectura de fondo de At13Adc.h: el proximo TOP larga una conversion, salvo que
+    // en ese TOP suba el pulso del servo (COM0B0) o que el pulso este alto (fin, ocr_bajada)
+    adc_fondo_disparo(!fin && !ocr_bajada && !(TCCR0A & (1 << COM0B0)));
+#endif
+}
+
+void timer0_init()
+{
+    sPulse = servo_objetivo = 100;
+    sei();                                 //  Enable global interrupts
+    OCR0A = 95;                            // Set CTC compare value (80us)
+    OCR0B = 0xff;                          // el servo arranca en el proximo frame
+    TCCR0A = (1 << WGM01) | (1 << COM0B1); // CTC, OC0B (servo) lo maneja el timer
+    TIMSK0 |= (1 << OCIE0A);               // Enable CTC interrupt
+    TCCR0B = (1 << CS01);                  // clock/8
+    Tick = 0;
+}
+
+// para dormir: sin clock el timer se queda quieto, la INT no entra y el tiempo no corre.
+// OC0A y OC0B quedan como estaban, asi que hay que llamarla sin tono y con el servo en reposo.
+void timer0_parar()
+{
+    TCCR0B = 0;
+}
+
+void timer0_seguir()
+{
+    TCCR0B = (1 << CS01); // clock/8, sigue en el mismo Tick
+}
+
+// rafaga a 9.6 MHz con el reloj lento (llamar con las INT cortadas, y despues reloj_rafaga_fin())
+void reloj_rafaga()
+{
+    if (reloj_lento)
+    {
+        clock_prescale_set(clock_div_1);
+        TCCR0B = (1 << CS01) | (1 << CS00); // clock/64: el timer sigue a 150 kHz
+    }
+}
+
+void reloj_rafaga_fin()
+{
+    if (reloj_lento)
+    {
+        clock_prescale_set(clock_div_8);
+        TCCR0B = (1 << CS01);
+    }
+}
+
+// suma frames enteros al tiempo (con el Timer0 parado o desde una INT)
+void frames_sumar(uint16_t n)
+{
+    Frames += n;
+    n += DecSeg;
+    while (n >= 50)
+    {
+        n -= 50;
+        UnSeg++;
+    }
+    DecSeg = n;
+}
+
+ISR(WDT_vect)
+{
+    frames_sumar(WDT_FRAMES);
+}
+
+// el Timer0 se congela y el WDT sigue contando el tiempo; despues hay que dormir
+// con sleep_mode() (cada WDT_DORMIDO despierta y vuelve al main)
+void dormido_iniciar()
+{
+    timer0_parar();
+    // modo INT sola (WDE = 0): en safety level 1 no hace falta la secuencia con WDCE
+    WDTCR = (1 << WDTIF) | (1 << WDTIE) | (WDT_DORMIDO & 7) | ((WDT_DORMIDO & 8) << 2);
+}
+
+void dormido_terminar()
+{
+    WDTCR = (1 << WDTIF); // WDT apagado, y sin INT pendiente
+    timer0_seguir();
+}
+
+#endif
@@ -4,10 +4,10 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/sleep.h>
 #include <util/delay.h>
-#include "At13Adc.h"
 
-#define F_CPU 9600000
 #define BUZZER _BV(PINB0)
 #define SERVO _BV(PINB1)
 #define LED _BV(PINB2)
@@ -15,6 +15,44 @@
 #define RELE _BV(PINB4)
 #define AGUA PINB5
 
+// el ADC da vueltas solo por el sensor, el LM35 contra Vcc y el LM35 contra 1.1V (ver At13Adc.h),
+// y la INT misma corta el rele si el sensor sale del agua (ver At13Agua.h).
+//  - el sensor solo se clasifica en 3 niveles: 8 bits rapido, contra Vcc (el divisor es de Vcc).
+//  - el LM35 a 10 bits contra 1.1V: 10mV/°C -> ~0.1°C por cuenta, 100°C = 931.
+//  - el LM35 contra Vcc solo sirve para medir Vcc (ver vcc_revisar()).
+#define ADC_CANAL_AGUA 0
+#define ADC_CANAL_LM35_VCC 1
+#define ADC_CANAL_LM35 2
+#define ADC_FONDO_PERFILES {ADC_RAPIDO(0), ADC_PRECISO(3), ADC_PRECISO(3) | ADC_1V1} // ADC0 = PB5, ADC3 = PB3
+// mediana de 3 en los tres: un pico suelto no queda en temperatura_max ni corta el calentamiento
+#define ADC_FONDO_MEDIANA
+#define AGUA_CORTE_PIN RELE
+#define ADC_FONDO_VIGIA(canal, valor) if (canal == ADC_CANAL_AGUA) agua_vigia(valor)
+
+#include "At13Agua.h"
+#include "At13Adc.h"
+#include "At13Boton.h"
+#include "At13Gamma.h"
+#include "At13ServoCal.h"
+#include "At13Timer0.h"
+
+#define F_CPU 9600000
+
+// 1 = la aguja marca la temperatura en forma continua (interpolando entre las marcas del dial)
+// 0 = la aguja salta entre las posiciones fijas POS_FRIO..POS_100
+#define AGUJA_CONTINUA 1
+
+// histeresis de la aguja en cuentas del ADC (~0.1°C c/u, LM35 contra 1.1V): para pasar a otra
+// ventana la lectura tiene que cruzar el borde TEMP_* por este margen (modo de posiciones fijas).
+#define HISTERESIS_AGUJA 9
+// zona muerta en ticks (10us): en modo continuo no se mueve la aguja por menos que esto.
+#define ZONA_MUERTA_AGUJA 2
+
+// frames de 20ms en idle (sin agua ni boton) antes de pasar a standby: 30 segundos
+#define STANDBY_FRAMES 1500
+// los ultimos frames antes del standby el LED recorre los colores (aviso): 5 segundos
+#define STANDBY_AVISO 250
+
 #define LED_AZUL LED_COLOR(0, 0, 255)
 #define LED_AMARILLO LED_COLOR(255, 255, 0)
 #define LED_ROJO LED_COLOR(255, 0, 0)
@@ -23,12 +61,8 @@
 uint16_t temperatura_buscada;
 uint8_t posicion_seleccionada;
 uint8_t r = 0, g = 0, b = 0; // para el color del led
-// primera posicion - 0°, ultima posicion - 180°
-uint16_t servo_microseconds[] = {60, 77, 95, 113, 131, 149, 166, 184, 202, 220, 238, 255, 273};
-volatile uint16_t Tick;   // 100KHz pulse
-volatile uint16_t sPulse; // Servo pulse variable
-volatile uint8_t UnSeg;
-volatile uint8_t DecSeg;
+// primera posicion - 0°, ultima posicion - 180° (en ticks de 10us, ver At13ServoCal.h)
+const uint16_t servo_ticks[] PROGMEM = SERVO_TABLA(SERVO_TICKS);
 
 /**
     AtTiny13 Datasheet:
@@ -41,9 +75,15 @@ volatile uint8_t DecSeg;
  */
 void ws2812b_change_color()
 {
+    // la INT del timer no puede cortar el tren de bits (y tampoco cambiar el pin
+    // del servo entre que leo PORTB y lo escribo): son 30us sin interrupciones.
+    const uint8_t sreg = SREG;
+    cli();
+    reloj_rafaga(); // los tiempos de abajo son a 9.6 MHz
     const uint8_t portb = PORTB; // PORTB is volatile, so preload value
     const uint8_t lo = portb & ~LED;
     const uint8_t hi = portb | LED;
+    const gamma_grb_t c = gamma_grb(r, g, b); // el LED recibe el color ya corregido (ver At13Gamma.h)
     __asm__ volatile(
         // Each 12 cycles go high on cycle 0 and go low on cycle:
         //   - 8 if a one bit is transmitted
@@ -189,20 +229,118 @@ void ws2812b_change_color()
         ".end:                          \n\t"
 
         : // No outputs
-        : [lo] "r"(lo), [hi] "r"(hi), [green] "r"(g), [red] "r"(r), [blue] "r"(b)
+        : [lo] "r"(lo), [hi] "r"(hi), [green] "r"(c.g), [red] "r"(c.r), [blue] "r"(c.b)
         : "r16", "r17");
 
     PORTB &= ~LED; // RESET
+    reloj_rafaga_fin();
+    SREG = sreg;
 }
 
 #define LED_COLOR(_r, _g, _b)   \
     {                           \
+        animacion = 0;          \
         r = _r;                 \
         g = _g;                 \
         b = _b;                 \
         ws2812b_change_color(); \
     }
 
+// animaciones del LED: avanzan un paso por frame (20ms) desde tareas(), sin delays.
+enum
+{
+    ANIM_RESPIRAR, // sube y baja el brillo del color, param = paso por frame
+    ANIM_TITILAR,  // param destellos del color y una pausa, param = cantidad (max 13)
+    ANIM_ARCOIRIS  // recorre todos los tonos, param = paso por frame (no usa el color)
+};
+
+typedef struct
+{
+    uint8_t tipo;
+    uint8_t r, g, b;
+    uint8_t param;
+} animacion_t;
+
+const animacion_t ANIM_CALENTANDO PROGMEM = {ANIM_RESPIRAR, 255, 0, 0, 6};
+const animacion_t ANIM_LISTO PROGMEM = {ANIM_TITILAR, 255, 255, 0, 2};
+const animacion_t ANIM_ARCOIRIS_LENTO PROGMEM = {ANIM_ARCOIRIS, 0, 0, 0, 2};
+
+const animacion_t *animacion; // 0 = color fijo (LED_COLOR)
+uint8_t anim_fase;
+
+void led_animar(const animacion_t *a)
+{
+    animacion = a;
+    anim_fase = 0;
+}
+
+uint8_t escalar_brillo(uint8_t c, uint8_t nivel)
+{
+    return ((uint16_t)c * nivel) >> 8;
+}
+
+void led_animacion_frame()
+{
+    if (!animacion)
+        return;
+
+    const uint8_t tipo = pgm_read_byte(&animacion->tipo);
+    const uint8_t param = pgm_read_byte(&animacion->param);
+    uint8_t nr = pgm_read_byte(&animacion->r);
+    uint8_t ng = pgm_read_byte(&animacion->g);
+    uint8_t nb = pgm_read_byte(&animacion->b);
+
+    if (tipo == ANIM_RESPIRAR)
+    {
+        // triangulo 0..254..0, un ciclo cada 256/param frames
+        anim_fase += param;
+        uint8_t nivel = anim_fase < 128 ? anim_fase << 1 : (255 - anim_fase) << 1;
+        nr = escalar_brillo(nr, nivel);
+        ng = escalar_brillo(ng, nivel);
+        nb = escalar_brillo(nb, nivel);
+    }
+    else if (tipo == ANIM_TITILAR)
+    {
+        // cada destello son 16 frames (8 prendido, 8 apagado) y despues 32 de pausa
+        if (++anim_fase >= (param << 4) + 32)
+            anim_fase = 0;
+        if (anim_fase >= (param << 4) || (anim_fase & 8))
+            nr = ng = nb = 0;
+    }
+    else
+    {
+        // 3 sectores de 85 pasos: rojo -> verde -> azul -> rojo
+        uint8_t h = anim_fase += param;
+        uint8_t x;
+        if (h < 85)
+        {
+            x = h + (h << 1);
+            nr = 255 - x, ng = x, nb = 0;
+        }
+        else if (h < 170)
+        {
+            h -= 85;
+            x = h + (h << 1);
+            nr = 0, ng = 255 - x, nb = x;
+        }
+        else
+        {
+            h -= 170;
+            x = h + (h << 1);
+            nr = x, ng = 0, nb = 255 - x;
+        }
+    }
+
+    // solo se manda al LED si el color cambio
+    if (nr != r || ng != g || nb != b)
+    {
+        r = nr;
+        g = ng;
+        b = nb;
+        ws2812b_change_color();
+    }
+}
+
 // posiciones del servo para cada visualizacion:
 enum
 {
@@ -223,81 +361,310 @@ enum
     POS_100   // >= 100°
 };
 
-// son valores directos del conversor ADC (ajustar con el LM35)
+// son valores directos del conversor ADC (ajustar con el LM35).
+// se calibraron en cada placa con Vref = Vcc (5V): TEMP_1V1() los pasa a una Vref de 1.1V justa.
+// El bandgap real de cada AtTiny13 esta entre 1.0 y 1.2V (+-9%, ~7°C en MATE), asi que la lectura
+// del LM35 no se compara directo: leer_temperatura() la corrige con la ganancia que se aprende
+// comparandola con el LM35 contra Vcc (ver vcc_revisar()), y queda en la escala de la calibracion.
+#define TEMP_1V1(adc_vcc) (((adc_vcc) * 5000L + 550) / 1100)
 enum
 {
-    TEMP_FRIO = 92, // menos de 50°C
-    TEMP_50 = 102,  //
-    TEMP_60 = 123,  //
-    TEMP_70 = 143,  //
-    TEMP_80 = 164,  //
-    TEMP_90 = 184,  //
-    TEMP_100 = 196  // mas de 96°C
+    TEMP_FRIO = TEMP_1V1(92), // menos de 50°C
+    TEMP_50 = TEMP_1V1(102),  //
+    TEMP_60 = TEMP_1V1(123),  //
+    TEMP_70 = TEMP_1V1(143),  //
+    TEMP_80 = TEMP_1V1(164),  //
+    TEMP_90 = TEMP_1V1(184),  //
+    TEMP_100 = TEMP_1V1(196)  // mas de 96°C
 };
 
-uint16_t temperaturas_seleccionadas[] = {TEMP_60, TEMP_70, TEMP_80, TEMP_90, TEMP_100};
+const uint16_t temperaturas_seleccionadas[] PROGMEM = {TEMP_60, TEMP_70, TEMP_80, TEMP_90, TEMP_100};
 
 #define RELE_ON PORTB |= RELE;
 #define RELE_OFF PORTB &= ~RELE;
-#define BUZZER_ON PORTB |= BUZZER;
-#define BUZZER_OFF PORTB &= ~BUZZER;
 
-#define mover_servo(index) sPulse = servo_microseconds[index];
+#define mover_servo(index) servo_pedir(pgm_read_word(&servo_ticks[index]));
+
+#if !AGUJA_CONTINUA
+// bordes superiores de las ventanas POS_FRIO..POS_90 (de ahi para arriba es POS_100)
+const uint16_t ventanas[] PROGMEM = {TEMP_FRIO, TEMP_50, TEMP_60, TEMP_70, TEMP_80, TEMP_90};
 
-///// *** Esta INT de timer mueve el servo motor ***
-///// Interrupcion de timer con frecuencia de 100Khz
-///// Se incrementa Tick cada 0.01mS (60 ticks son .6ms, 273 ticks son 2.73ms)
-ISR(TIM0_COMPA_vect)
+// busco una ventana donde cuadre la temperatura:
+uint8_t ventana_temperatura(uint16_t t)
 {
-    if (Tick >= 2000)
-    { // One servo frame (20ms) completed
-        Tick = 0;
-        if (DecSeg++ >= 50)
-        {
-            UnSeg++; // un segundo completo
-        }
+    uint8_t index = POS_FRIO;
+    while (index < POS_100 && t > pgm_read_word(&ventanas[index - POS_FRIO]))
+        index++;
+    return index;
+}
+
+// igual que ventana_temperatura() pero solo se cambia la posicion actual si la
+// lectura paso el borde por HISTERESIS_AGUJA (asi la aguja no tiembla en un borde).
+uint8_t ventana_con_histeresis(uint16_t t, uint8_t actual)
+{
+    uint8_t index = ventana_temperatura(t > HISTERESIS_AGUJA ? t - HISTERESIS_AGUJA : 0);
+    if (index > actual)
+        return index;
+    index = ventana_temperatura(t + HISTERESIS_AGUJA);
+    if (index < actual)
+        return index;
+    return actual;
+}
+#else
+// tramos rectos entre las marcas del dial: temperatura (ADC) -> pulso (ticks).
+// la pendiente se guarda en punto fijo 8.8 y se calcula al compilar, asi en
+// runtime no hay divisiones: pulso = p0 + ((t - t0) * pendiente) >> 8
+typedef struct
+{
+    uint16_t temp;
+    uint16_t pulso;
+    uint16_t pendiente;
+} tramo_t;
+
+#define TRAMO(t0, p0, t1, p1) {t0, p0, (((p1) - (p0)) * 256 + ((t1) - (t0)) / 2) / ((t1) - (t0))}
+
+const tramo_t tramos[] PROGMEM = {
+    TRAMO(TEMP_FRIO, SERVO_TICKS(POS_FRIO), TEMP_50, SERVO_TICKS(POS_50)),
+    TRAMO(TEMP_50, SERVO_TICKS(POS_50), TEMP_60, SERVO_TICKS(POS_60)),
+    TRAMO(TEMP_60, SERVO_TICKS(POS_60), TEMP_70, SERVO_TICKS(POS_70)),
+    TRAMO(TEMP_70, SERVO_TICKS(POS_70), TEMP_80, SERVO_TICKS(POS_80)),
+    TRAMO(TEMP_80, SERVO_TICKS(POS_80), TEMP_90, SERVO_TICKS(POS_90)),
+    TRAMO(TEMP_90, SERVO_TICKS(POS_90), TEMP_100, SERVO_TICKS(POS_100))};
+#define N_TRAMOS (sizeof(tramos) / sizeof(tramos[0]))
+
+// temperatura (ADC) -> ancho de pulso del servo (ticks de 10us)
+// ((t - t0) * pendiente es mas o menos (p1 - p0) * 256, entra en 16 bits)
+uint16_t temperatura_a_pulso(uint16_t t)
+{
+    if (t <= TEMP_FRIO)
+        return SERVO_TICKS(POS_FRIO);
+    if (t >= TEMP_100)
+        return SERVO_TICKS(POS_100);
+
+    const tramo_t *tr = tramos;
+    while (tr < &tramos[N_TRAMOS - 1] && t > pgm_read_word(&tr[1].temp))
+        tr++;
+    return pgm_read_word(&tr->pulso) + (((t - pgm_read_word(&tr->temp)) * pgm_read_word(&tr->pendiente) + 128) >> 8);
+}
+#endif
+
+// estado del sensor de agua y del pulsador (que es el mismo), ya filtrado:
+// 0 = nada, 1 = boton, -1 = agua. Lo actualiza tareas() una vez por frame (ver At13Agua.h).
+#define leer_adc_agua() agua_estado
+
+// no bloquea, suena 40ms en el fondo
+void beep()
+{
+    tono(TONO_MEDIO, 2);
+}
+
+// melodias en flash, 1 byte por nota: altura (3 bits, 0 = silencio) | frames de 20ms (5 bits).
+// un 0 termina la melodia. Las toca tareas() de fondo, una nota tras otra.
+#define NOTA(altura, frames) (((altura) << 5) | (frames))
+
+// altura -> k del timer (ver tono())
+const uint8_t alturas[] PROGMEM = {0, 21, 19, 17, 16, 14, 13, 12};
+
+const uint8_t MELODIA_LISTO[] PROGMEM = {NOTA(1, 5), NOTA(3, 5), NOTA(5, 5), NOTA(7, 15), 0};
+const uint8_t MELODIA_SIN_AGUA[] PROGMEM = {NOTA(7, 5), NOTA(4, 5), NOTA(1, 15), 0};
+const uint8_t MELODIA_PRESET[] PROGMEM = {NOTA(6, 3), NOTA(0, 2), NOTA(6, 3), 0};
+
+const uint8_t *melodia; // 0 = no suena nada
+uint8_t nota_frames;    // frames que le quedan a la nota actual
+
+void sonar(const uint8_t *m)
+{
+    melodia = m;
+    nota_frames = 0;
+}
+
+void melodia_frame()
+{
+    if (!melodia || (nota_frames && --nota_frames))
+        return;
+
+    const uint8_t n = pgm_read_byte(melodia);
+    if (!n)
+    {
+        melodia = 0;
+        return;
     }
-    Tick++;
-    if (Tick <= sPulse) // Generate servo pulse
+    melodia++;
+    nota_frames = n & 0x1f;
+    // un frame de mas, asi no se corta antes de que llegue la nota siguiente
+    tono(pgm_read_byte(&alturas[n >> 5]), nota_frames + 1);
+}
+
+// ganancia del LM35 contra 1.1V: lectura corregida = lectura x (1 + lm35_ajuste / 256).
+// Se guarda en la EEPROM (al empezar a calentar), asi arranca ya ajustada.
+#define LM35_AJUSTE_MAX 32 // +-12.5%, alcanza para un bandgap de 1.0 a 1.2V
+int8_t lm35_ajuste;
+int8_t EEMEM lm35_ajuste_ee;
+
+void lm35_ajuste_iniciar()
+{
+    const int8_t e = eeprom_read_byte((const uint8_t *)&lm35_ajuste_ee);
+    if (e >= -LM35_AJUSTE_MAX && e <= LM35_AJUSTE_MAX) // 0xff = EEPROM borrada = -1, tambien sirve
+        lm35_ajuste = e;
+}
+
+void lm35_ajuste_guardar()
+{
+    eeprom_update_byte((uint8_t *)&lm35_ajuste_ee, lm35_ajuste);
+}
+
+// LM35 contra 1.1V, en la escala de TEMP_* (t x ajuste entra en 16 bits con signo: 1023 x 32)
+uint16_t leer_temperatura()
+{
+    const uint16_t t = adc_fondo_leer(ADC_CANAL_LM35);
+    return t + (((int16_t)t * lm35_ajuste) >> 8);
+}
+
+// El ADC del AtTiny13 no puede leer el bandgap, pero el LM35 leido contra las dos referencias
+// da la relacion entre Vcc y el bandgap. El mismo voltaje contra Vcc, pasado a la escala de 1.1V
+// como las TEMP_* (c = lm35_vcc x 4.547, TEMP_1V1() sin dividir), tiene que dar la lectura
+// corregida: con rele y servo quietos (sin caida de Vcc) se corre lm35_ajuste un paso (0.4%)
+// cada 16 frames hacia ahi. Asi la ganancia absorbe lo que el bandgap se aleja de 1.1V.
+// Vcc baja cuando tiran el rele o el servo, y ya ajustado Vcc / Vcc_idle = lectura / c:
+// se compara, en decimas de volt sobre 5V, 50 x lectura contra VCC_xx_DV x c (entra en 16 bits).
+// Las lecturas no dejan de usarse con Vcc bajo: el LM35 contra 1.1V y el divisor del sensor
+// (que es de Vcc) no dependen de Vcc. Lo unico que hace un Vcc bajo sostenido (VCC_BAJO_FRAMES)
+// es terminar el calentamiento con el rele apagado y el LED titilando ANIM_VCC_BAJO
+// (naranja, 3 destellos: distinto de ANIM_LISTO y de los rojos de ANIM_FALLA).
+// Debajo de ~15°C (lm35_vcc < 30) la cuenta es muy gruesa y todo queda como estaba;
+// arriba de 255 (~125°C) es una falla (ver lm35_revisar()).
+#define VCC_BAJO_DV 40 // aviso debajo de 4.0V
+#define VCC_OK_DV 42   // y se levanta arriba de 4.2V
+#define VCC_BAJO_FRAMES 50 // 1 segundo seguido debajo de 4.0V corta el rele
+const animacion_t ANIM_VCC_BAJO PROGMEM = {ANIM_TITILAR, 255, 96, 0, 3};
+uint8_t vcc_bajo; // frames con Vcc debajo de VCC_BAJO_DV (0 = Vcc bien, hasta 255)
+void vcc_revisar()
+{
+    const uint16_t v = adc_fondo_leer(ADC_CANAL_LM35_VCC);
+    if (v < 30 || v > 255)
+        return;
+    const uint16_t a = leer_temperatura();
+    const uint16_t c = (v << 2) + ((v * 35) >> 6);
+    if (!(Frames & 15) && !vcc_bajo && !(PORTB & RELE) && servo_quieto >= SERVO_REPOSO)
     {
-        PORTB |= SERVO;
+        if (a > c && lm35_ajuste > -LM35_AJUSTE_MAX)
+            lm35_ajuste--;
+        else if (a < c && lm35_ajuste < LM35_AJUSTE_MAX)
+            lm35_ajuste++;
     }
-    else
+    if (a * 50 < VCC_BAJO_DV * c)
     {
-        PORTB &= ~SERVO;
+        if (vcc_bajo < 255)
+            vcc_bajo++;
     }
+    else if (a * 50 > VCC_OK_DV * c)
+        vcc_bajo = 0;
 }
 
-void pwm_init()
+// salud del LM35, una vez por frame desde tareas(). Si el cable se corta o hace falso
+// contacto la entrada queda flotando o en un riel, y controlar_temperatura() nunca llegaria
+// a la temperatura (rele prendido para siempre) o terminaria enseguida. Fallas:
+//  1 destello:  ABIERTO, lectura en el riel de abajo (cable cortado o a masa)
+//  2 destellos: CORTO, el LM35 contra Vcc muy arriba (corto a Vcc). Se mira contra Vcc y no
+//               contra 1.1V: con un bandgap de 1.0V el agua hirviendo ya llega a 1023 ahi.
+//  3 destellos: SALTO, pendiente imposible (mas de ~2°C en un frame, 100°C/s)
+//  4 destellos: QUIETO, con el rele prendido la lectura no cambia ni una cuenta (varianza 0)
+// Las 3 primeras se dan por buenas con LM35_FALLA_FRAMES frames seguidos (60ms, despues de
+// la mediana del ADC); QUIETO tarda LM35_QUIETO_SEG segundos. Con una falla se apaga el rele,
+// el LED titila en rojo la cantidad de veces de la falla y no se calienta mas hasta reiniciar.
+#define LM35_RIEL_BAJO 10   // ~1°C
+#define LM35_RIEL_ALTO 250  // contra Vcc como la calibracion: ~122°C (TEMP_100 es 196)
+#define LM35_SALTO_MAX 20   // cuentas por frame (~2°C)
+#define LM35_FALLA_FRAMES 3
+#define LM35_QUIETO_SEG 30
+
+enum
 {
-    sei();                   //  Enable global interrupts
-    TCCR0A |= (1 << WGM01);  // Configure timer 1 for CTC mode
-    TIMSK0 |= (1 << OCIE0A); // Enable CTC interrupt
-    OCR0A = 95;              // Set CTC compare value
-    TCCR0B |= (1 << CS00);   // No prescaler
-    Tick = 0;
-    sPulse = 100;
-}
+    FALLA_NADA,
+    FALLA_ABIERTO,
+    FALLA_CORTO,
+    FALLA_SALTO,
+    FALLA_QUIETO
+};
+
+const animacion_t ANIM_FALLA[] PROGMEM = {
+    {ANIM_TITILAR, 255, 0, 0, FALLA_ABIERTO},
+    {ANIM_TITILAR, 255, 0, 0, FALLA_CORTO},
+    {ANIM_TITILAR, 255, 0, 0, FALLA_SALTO},
+    {ANIM_TITILAR, 255, 0, 0, FALLA_QUIETO}};
+
+uint8_t lm35_falla;  // FALLA_NADA o la falla que se encontro (queda hasta reiniciar)
+uint16_t lm35_ant;   // ultima lectura buena (0 = todavia no hay, 1 = se esta llenando la mediana)
+uint8_t lm35_malas;  // frames seguidos con falla
+uint8_t lm35_quieto; // segundos con el rele prendido y la lectura clavada
 
-// lee la entrada del sensor de agua y del pulsador (que es el mismo)
-int8_t leer_adc_agua()
+void lm35_revisar()
 {
-    adc_setup_10(PINB5);
-    uint16_t t = adc_read_10();
-    if (t < 650)
-        return 0; // nada (Vcc/2)
-    else if (t > 900)
-        return 1; // boton (Vcc)
+    // recien despierto (o al arrancar) adc_fondo tiene lo de antes de dormir: hasta que
+    // no haya lecturas nuevas no se revisa nada
+    if (lm35_falla || !adc_fondo_nueva(ADC_CANAL_LM35) || !adc_fondo_nueva(ADC_CANAL_LM35_VCC))
+        return;
+
+    const uint16_t t = adc_fondo_leer(ADC_CANAL_LM35);
+    uint8_t falla = FALLA_NADA;
+    if (t < LM35_RIEL_BAJO)
+        falla = FALLA_ABIERTO;
+    else if (adc_fondo_leer(ADC_CANAL_LM35_VCC) > LM35_RIEL_ALTO)
+        falla = FALLA_CORTO;
+    else if (lm35_ant > 1 && (t > lm35_ant + LM35_SALTO_MAX || t + LM35_SALTO_MAX < lm35_ant))
+        falla = FALLA_SALTO; // se sigue comparando con la ultima buena
     else
-        return -1; // agua (aprox 3/4 Vcc)
+    {
+        // varianza 0: se cuentan los segundos (DecSeg en 0) sin que cambie ni una cuenta
+        if (t != lm35_ant || !(PORTB & RELE))
+            lm35_quieto = 0;
+        else if (!DecSeg && ++lm35_quieto >= LM35_QUIETO_SEG)
+            falla = FALLA_QUIETO;
+        // sin referencia la pendiente se saltea: un frame para que la mediana se llene
+        // con lecturas nuevas (0 -> 1) y la referencia sale del siguiente
+        lm35_ant = lm35_ant ? t : 1;
+        if (falla == FALLA_NADA)
+        {
+            lm35_malas = 0;
+            return;
+        }
+    }
+    if (falla != FALLA_QUIETO && ++lm35_malas < LM35_FALLA_FRAMES)
+        return;
+
+    lm35_falla = falla;
+    agua_vigia_desarmar();
+    RELE_OFF;
+    led_animar(&ANIM_FALLA[falla - 1]);
 }
 
-void beep()
+// tareas de fondo que corren una vez por frame (20ms).
+// hay que llamarla seguido desde todos los loops (no bloquea).
+// devuelve 1 si empezo un frame nuevo.
+uint8_t frame_ant;
+uint8_t tareas()
 {
-    BUZZER_ON;
-    delay(11);
-    BUZZER_OFF;
-    delay(11);
+    if (Frames == frame_ant)
+        return 0;
+    frame_ant = Frames;
+    led_animacion_frame();
+    melodia_frame();
+    vcc_revisar();
+    if (adc_fondo_nueva(ADC_CANAL_AGUA)) // recien despierto puede no haber lectura todavia
+        agua_muestra(adc_fondo_leer(ADC_CANAL_AGUA));
+    lm35_revisar();
+    boton_muestra(leer_adc_agua() == 1);
+    return 1;
+}
+
+// muestra el preset con la aguja y lo deja como temperatura buscada
+void seleccionar(uint8_t posicion)
+{
+    LED_MAGENTA;
+    posicion_seleccionada = posicion;
+    mover_servo(posicion);
+    temperatura_buscada = pgm_read_word(&temperaturas_seleccionadas[posicion - 1]);
+    sonar(MELODIA_PRESET);
 }
 
 // determina la temperatura y posiciona el servo.
@@ -306,48 +673,110 @@ void beep()
 void controlar_temperatura()
 {
     uint16_t temperatura_actual, temperatura_max = 0;
-    LED_ROJO;
+#if AGUJA_CONTINUA
+    uint16_t pulso_ant = 0;
+#else
+    uint8_t index_ant = 0xff; // todavia no se mostro nada
+#endif
+    boton_vaciar(); // calentando el boton no hace nada: lo que se apriete no se guarda
+    led_animar(&ANIM_CALENTANDO);
     RELE_ON;
+    agua_vigia_armar();
     beep();
 
     // mientras leo temperatura y muevo el motor, verifico si llego a la temp buscada
-    // (si se saca el sensor del agua tambien termina)
-    while (temperatura_max < temperatura_buscada && leer_adc_agua() != 0)
+    // (si se saca el sensor del agua tambien termina, si la vigia o una falla del LM35 ya cortaron
+    // el rele, y si Vcc queda bajo VCC_BAJO_FRAMES: ahi se corta el rele sin llegar a la temperatura)
+    while (temperatura_max < temperatura_buscada && leer_adc_agua() != 0 && !agua_cortado && !lm35_falla &&
+           vcc_bajo < VCC_BAJO_FRAMES)
     {
-        // leo temperatura:
-        adc_setup_10(PINB3);
-        temperatura_actual = adc_read_10();
+        // leo temperatura (la ultima que dejo la INT del ADC):
+        temperatura_actual = leer_temperatura();
 
         // guardo siempre la max.
         if (temperatura_max < temperatura_actual)
             temperatura_max = temperatura_actual;
 
-        // busco una ventana donde cuadre la temperatura:
-        int8_t index;
-        if (temperatura_max <= TEMP_FRIO)
-            index = POS_FRIO;
-        else if (temperatura_max <= TEMP_50)
-            index = POS_50;
-        else if (temperatura_max <= TEMP_60)
-            index = POS_60;
-        else if (temperatura_max <= TEMP_70)
-            index = POS_70;
-        else if (temperatura_max <= TEMP_80)
-            index = POS_80;
-        else if (temperatura_max <= TEMP_90)
-            index = POS_90;
-        else
-            index = POS_100;
-
-        // muestro la temp con el servo:
-        mover_servo(index);
+        // muestro la temp con el servo (solo si cambio, la INT hace el resto):
+#if AGUJA_CONTINUA
+        uint16_t pulso = temperatura_a_pulso(temperatura_max);
+        if (pulso > pulso_ant + ZONA_MUERTA_AGUJA || pulso + ZONA_MUERTA_AGUJA < pulso_ant)
+        {
+            pulso_ant = pulso;
+            servo_pedir(pulso);
+        }
+#else
+        uint8_t index = ventana_con_histeresis(temperatura_max, index_ant);
+        if (index != index_ant)
+        {
+            index_ant = index;
+            mover_servo(index);
+        }
+#endif
+        tareas();
     }
 
     // ** FIN **
-    LED_AMARILLO;
+    agua_vigia_desarmar();
     RELE_OFF;
-    beep();
-    beep();
+    if (lm35_falla)
+        return; // el LED ya muestra la falla
+    if (temperatura_max < temperatura_buscada && vcc_bajo >= VCC_BAJO_FRAMES)
+    {
+        led_animar(&ANIM_VCC_BAJO); // corto por Vcc bajo, no llego a la temperatura
+        return;
+    }
+    LED_AMARILLO;
+    if (temperatura_max >= temperatura_buscada)
+        sonar(MELODIA_LISTO);
+    led_animar(&ANIM_LISTO);
+}
+
+// el pin change solo despierta al micro, lo demas lo hace standby()
+EMPTY_INTERRUPT(PCINT0_vect);
+
+// lo que corre dormido, en cada despertada (WDT cada 500ms o pin change).
+// devuelve 1 si hay que despertar: por ahora, agua o boton.
+uint8_t tareas_dormido()
+{
+    adc_setup_10(PINB5);
+    const uint16_t t = adc_read_10();
+    adc_fondo_parar(); // el ADC prendido gasta aunque el micro duerma
+    return t >= agua_base() + AGUA_SOBRE_BASE;
+}
+
+// standby (sin melodia ni tono y con la aguja en reposo): apaga el LED, el ADC y el Timer0 y duerme en
+// power-down. Lo despiertan el pin del sensor/pulsador (PCINT5) y el WDT, que ademas lleva el
+// tiempo (ver dormido_iniciar() en At13Timer0.h); en cada despertada se mira el sensor con el ADC.
+// Limites:
+//  - sin agua el pin queda en Vcc/2, cerca del umbral digital: puede haber despertadas
+//    de mas y, si el pin en idle ya se lee como 1, el agua (1) no produce cambio;
+//    ahi el agua se ve en la siguiente despertada del WDT (500ms como mucho).
+//  - consumo del micro (segun el datasheet): WDT ~4uA + una conversion
+//    de 0.35ms cada 500ms ~3uA. El de la placa queda en lo que tiran el divisor del sensor,
+//    el WS2812B apagado (~1mA) y la electronica del servo, que no se cortan por software.
+// Despertar (calculado con el datasheet): 6 ciclos de arranque del oscilador interno,
+// ~0.3ms de la conversion de confirmacion y 0.35ms hasta las primeras lecturas de fondo;
+// despues la votacion de At13Agua.h tarda 3 frames (60-80ms) en dar "agua".
+void standby()
+{
+    LED_COLOR(0, 0, 0);
+    adc_fondo_parar();
+    ACSR = (1 << ACD); // el comparador analogico tambien consume
+    PCMSK = (1 << PCINT5);
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    dormido_iniciar();
+    do
+    {
+        GIFR = (1 << PCIF);
+        GIMSK |= (1 << PCIE);
+        sleep_mode();
+        GIMSK &= ~(1 << PCIE);
+    } while (!tareas_dormido());
+    dormido_terminar();
+
+    adc_fondo_iniciar();
+    lm35_ant = 0; // dormido el agua pudo cambiar de temperatura: la pendiente arranca de nuevo
     LED_AZUL;
 }
 
@@ -359,43 +788,66 @@ int main()
     DDRB = 0b010111;
 
     LED_AZUL;
-    pwm_init();
+    agua_iniciar();
+    lm35_ajuste_iniciar();
+    adc_fondo_iniciar();
+    timer0_init();
     beep();
 
     temperatura_buscada = TEMP_80; // temperatura por defecto=MATE
     posicion_seleccionada = 2;     // 2=MATE
 
+    uint16_t frames_idle = 0;
     while (1)
     {
+        // el pulsador lo muestrea tareas() una vez por frame, aca solo se consumen los eventos
+        const uint8_t nuevo_frame = tareas();
+        const uint8_t ev = boton_evento();
+        if (ev || leer_adc_agua())
+            frames_idle = 0;
+        if (lm35_falla)
+            continue; // sin LM35 no se calienta: queda titilando la falla
+
         // SENSOR EN EL AGUA! START!!
         if (leer_adc_agua() == -1)
         {
+            reloj_lento_ok = 0; // calentando: el ADC y la vigia a toda velocidad
+            agua_guardar(); // la base y la ganancia aprendidas en idle, para el proximo arranque
+            lm35_ajuste_guardar();
             controlar_temperatura();
             // listo, ya calentó....espero sacar el sensor del agua....
             while (leer_adc_agua() == -1)
-                ;
+                tareas();
+            boton_vaciar(); // ni lo apretado esperando, no son cambios de preset
             mover_servo(POS_APAGADO);
+            if (lm35_falla)
+                continue;
+            LED_AZUL;
+            sonar(MELODIA_SIN_AGUA);
         }
 
-        // boton pulsado? selecciono proxima temperatura:
-        else if (leer_adc_agua() == 1)
-        {
-            LED_MAGENTA;
-            if (++posicion_seleccionada > POS_HERVIR)
-                posicion_seleccionada = POS_TE_BLANCO;
-            mover_servo(posicion_seleccionada);
-            temperatura_buscada = temperaturas_seleccionadas[posicion_seleccionada - 1];
-            beep();
-            _delay_loop_2(65000);
-        }
+        // boton: corto = proximo preset, doble = el anterior, largo = vuelve a MATE
+        else if (ev == BOTON_CORTO)
+            seleccionar(posicion_seleccionada >= POS_HERVIR ? POS_TE_BLANCO : posicion_seleccionada + 1);
+        else if (ev == BOTON_DOBLE)
+            seleccionar(posicion_seleccionada <= POS_TE_BLANCO ? POS_HERVIR : posicion_seleccionada - 1);
+        else if (ev == BOTON_LARGO)
+            seleccionar(POS_MATE);
 
-        // idle
+        // idle: si no pasa nada en STANDBY_FRAMES, a dormir
         else
         {
-            _delay_loop_2(10000);
-            if (UnSeg == 5)
+            reloj_lento_ok = 1; // la INT baja el reloj cuando no hay tono ni servo
+            if (nuevo_frame && UnSeg == 5 && !DecSeg)
+                beep(); // una vez por vuelta de UnSeg (a los 5 segundos, y cada 256)
+            if (nuevo_frame && frames_idle < STANDBY_FRAMES && ++frames_idle == STANDBY_FRAMES - STANDBY_AVISO)
+                led_animar(&ANIM_ARCOIRIS_LENTO); // cualquier evento lo cambia por su color
+            // espera a que termine de sonar y de acomodar la aguja: la melodia y tambien su
+            // ultima nota o un beep() (tono_k), timer0_parar() no puede cortar un tono en OC0A
+            if (frames_idle >= STANDBY_FRAMES && !melodia && !tono_k && servo_quieto >= SERVO_REPOSO)
             {
-                 beep();
+                standby();
+                frames_idle = 0;
             }
         }
     }
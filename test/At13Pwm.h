@@ -22,6 +22,12 @@
 #include <Arduino.h>
 #include <avr/io.h>
 
+// el Timer0 es uno solo (ver src/At13Timer0.h)
+#ifdef TIMER0_DUENO
+#error "El Timer0 ya lo usa otro archivo (ver TIMER0_DUENO)"
+#endif
+#define TIMER0_DUENO "At13Pwm.h"
+
 void pwm_setup_0()
 {
     DDRB |= 1; // bit 0 as an output
@@ -15,24 +15,26 @@
 #include <Arduino.h>
 
 // aprox. 13.84 grados = 14 posiciones
-// (esta calibrado para el AtTiny13 y el micro-servo azul)
-const int servo_positions[] = {600, 763, 926, 1089, 1252, 1415, 1578,
-                               1741, 1904, 2067, 2230, 2393, 2556, 2730};
+// (esta calibrado para el AtTiny13 y el micro-servo azul, ver At13ServoCal.h)
+#define SERVO_POSICIONES 14
+#include "At13ServoCal.h"
+const uint16_t servo_positions[] PROGMEM = SERVO_TABLA(SERVO_US);
 
 void servo_setup(uint8_t pin)
 {
     pinMode(pin, OUTPUT);
 }
 
-// posiciona el servo en una de las 14 posiciones
-// Flash:214 bytes, Ram:30 bytes
+// posiciona el servo en una de las 14 posiciones (bloquea 600ms)
+// Flash:214 bytes, Ram:30 bytes con la tabla en RAM; ahora la tabla esta en flash:
+// Ram:2 bytes y ~218 bytes de flash (el pgm_read_word suma 4, estimado contando instrucciones)
 void servo_move_table(uint8_t pin, uint8_t index)
 {
     if (index < 0)
         index = 0;
     if (index > 13)
         index = 13;
-    volatile int z = servo_positions[index];
+    volatile int z = pgm_read_word(&servo_positions[index]);
     for (uint8_t i = 0; i < 30; i++)
     {
         digitalWrite(pin, HIGH);
@@ -42,15 +44,16 @@ void servo_move_table(uint8_t pin, uint8_t index)
     }
 }
 
-// posiciona el servo en grados de 0 a 180
-// Flash:364 bytes, Ram:2 bytes
+// posiciona el servo en grados de 0 a 180 (bloquea 600ms)
+// Flash:364 bytes, Ram:2 bytes con map(); SERVO_US_GRADOS() cambia la division de 32 bits
+// por una multiplicacion de 16: ~260 bytes (estimado contando instrucciones)
 void servo_move(uint8_t pin, uint8_t grados)
 {
     if (grados < 0)
         grados = 0;
     if (grados > 180)
         grados = 180;
-    volatile int z = map(grados, 0, 180, 600, 2730);
+    volatile int z = SERVO_US_GRADOS(grados);
     for (uint8_t i = 0; i < 30; i++)
     {
         digitalWrite(pin, HIGH);
@@ -60,51 +63,130 @@ void servo_move(uint8_t pin, uint8_t grados)
     }
 }
 
-// Flash:594 bytes, Ram:32 bytes
+// ----------------------------------------------------------------------------
+// La clase (solo con #define SERVO_CLASE antes del include) no bloquea: el pulso
+// lo hace el hardware en OC0B (PB1), con el Timer0 en CTC a clock/8 y una INT cada
+// 80us, como el servo de src/At13Timer0.h (ahi esta explicado):
+//  - sube con "set on compare" en el TOP que cierra el frame de 20ms,
+//  - baja con "clear on compare" en OCR0B, que se carga en el periodo de la bajada,
+// asi el ancho no depende de cuando entra la INT.
+// move() vuelve enseguida; el servo recibe SERVO_FRAMES_MOVER pulsos (lo mismo
+// que antes se esperaba con delay, 600ms) y despues se suelta solo.
+// llego() dice si ya termino.
+//
+// ** usa el Timer0 y el pin PB1: no mezclar con At13Pwm.h ni con src/At13Timer0.h **
+// Las funciones de arriba no usan el timer y se pueden usar sin la clase.
+//
+// INT: ~50 ciclos cada 768 (80us), ~7% de la CPU.
+// ----------------------------------------------------------------------------
+#ifdef SERVO_CLASE
+#include <avr/interrupt.h>
+
+#if F_CPU != 9600000UL
+#error "Los tiempos de la clase Servo estan calculados para F_CPU = 9600000UL"
+#endif
+
+// el Timer0 es uno solo (ver src/At13Timer0.h)
+#ifdef TIMER0_DUENO
+#error "El Timer0 ya lo usa otro archivo (ver TIMER0_DUENO)"
+#endif
+#define TIMER0_DUENO "At13Servo.h"
+
+#define SERVO_FRAMES_MOVER 30
+
+// solo un servo (hay un solo timer y un solo OC0B)
+const uint16_t servo_ticks[] PROGMEM = SERVO_TABLA(SERVO_TICKS);
+volatile uint8_t servo_frames;   // frames que faltan (0 = llego, sin pulsos)
+volatile uint16_t servo_pulso;   // ancho del pulso en ticks de 10us
+
+///// un periodo de 80us = 8 ticks de 10us = 96 cuentas del timer (12 por tick);
+///// el frame son 250 periodos. La INT entra al empezar cada periodo.
+ISR(TIM0_COMPA_vect)
+{
+    static uint8_t periodo;     // el periodo que empieza (0..249)
+    static uint8_t baja = 0xff; // periodo en que baja el pulso
+    static uint16_t pulso;      // ancho del pulso que sale en este frame
+
+    const uint8_t p = periodo;
+    if (p == 249)
+    {
+        periodo = 0;
+        if (servo_frames)
+        {
+            // el TOP que cierra el frame sube el pulso (servo_pulso no cambia con servo_frames != 0)
+            pulso = servo_pulso;
+            OCR0B = OCR0A;
+            TCCR0A |= (1 << COM0B0); // set OC0B on compare match
+        }
+        return;
+    }
+    periodo = p + 1;
+    if (!p)
+    {
+        if (TCCR0A & (1 << COM0B0))
+        { // subio: queda listo para bajarlo
+            OCR0B = 0xff; // nunca llega (TOP = 95)
+            TCCR0A &= ~(1 << COM0B0); // clear OC0B on compare match
+            baja = (pulso - 1) >> 3;
+            servo_frames--;
+        }
+    }
+    else if (p == baja)
+    {
+        const uint8_t d = pulso - (p << 3); // 1..8 ticks dentro del periodo
+        OCR0B = (d << 3) + (d << 2) - 1;
+    }
+    else if (p == baja + 1)
+        TCCR0B |= (1 << FOC0B); // por si la INT entro tarde y el compare ya habia pasado
+}
+
+// Flash: ~320 bytes (la INT ~180, la tabla 28), Ram:7 bytes (estimado contando instrucciones;
+// la clase vieja, bloqueante, media 594 bytes y 32 de Ram)
 class Servo
 {
 public:
-    uint8_t _pin = -1;
-
-    void setup(uint8_t pin)
+    // el pulso sale siempre por PB1 (OC0B)
+    void setup()
     {
-        _pin = pin;
-        pinMode(_pin, OUTPUT);
+        DDRB |= (1 << PINB1);
+        OCR0A = 95;                            // 1.2 MHz / 96 = 80us
+        OCR0B = 0xff;
+        TCCR0A = (1 << WGM01) | (1 << COM0B1); // CTC, OC0B lo maneja el timer
+        TIMSK0 |= (1 << OCIE0A);               // Enable CTC interrupt
+        TCCR0B = (1 << CS01);                  // clock/8
+        sei();
     }
 
     // ** index va de 0 a 13 !! **
     void move_table(uint8_t index)
     {
-        if (index < 0)
-            index = 0;
         if (index > 13)
             index = 13;
-        // (esta calibrado para el AtTiny13 y el micro-servo azul)
-        volatile int z = servo_positions[index];
-        for (uint8_t i = 0; i < 30; i++)
-        {
-            digitalWrite(_pin, HIGH);
-            delayMicroseconds(z);
-            digitalWrite(_pin, LOW);
-            delay(20);
-        }
+        pulso(pgm_read_word(&servo_ticks[index]));
     }
 
     void move(uint8_t grados)
     {
-        if (grados < 0)
-            grados = 0;
         if (grados > 180)
             grados = 180;
-        volatile int z = map(grados, 0, 180, 600, 2730);
-        for (uint8_t i = 0; i < 30; i++)
-        {
-            digitalWrite(_pin, HIGH);
-            delayMicroseconds(z);
-            digitalWrite(_pin, LOW);
-            delay(20);
-        }
+        pulso(SERVO_TICKS_GRADOS(grados));
+    }
+
+    // true cuando ya se mandaron todos los pulsos del ultimo move
+    bool llego()
+    {
+        return servo_frames == 0;
+    }
+
+private:
+    // la INT solo lee servo_pulso con servo_frames != 0, asi nunca lo lee a medias
+    void pulso(uint16_t ticks)
+    {
+        servo_frames = 0;
+        servo_pulso = ticks;
+        servo_frames = SERVO_FRAMES_MOVER;
     }
 };
+#endif
 
 #endif
@@ -19,13 +19,15 @@
 #include <avr/io.h>
 #include <inttypes.h>
 #include <util/delay.h>
+#include "At13Gamma.h"
 
 #if F_CPU != 9600000UL
 #error "El WS2812B solo se puede usar con una frecuencia de reloj F_CPU de 9600000UL"
 #endif
 
-void ws2812b_set_color_no_reset(const uint8_t pin_value, const uint8_t red, const uint8_t green, const uint8_t blue)
+void ws2812b_set_color_no_reset(const uint8_t pin_value, uint8_t red, uint8_t green, uint8_t blue)
 {
+    const gamma_grb_t c = gamma_grb(red, green, blue); // el LED recibe el color ya corregido (ver At13Gamma.h)
     DDRB |= pin_value;
     const uint8_t portb = PORTB; // PORTB is volatile, so preload value
     const uint8_t lo = portb & ~pin_value;
@@ -175,7 +177,7 @@ void ws2812b_set_color_no_reset(const uint8_t pin_value, const uint8_t red, cons
         ".end:                          \n\t"
 
         : // No outputs
-        : [lo] "r"(lo), [hi] "r"(hi), [green] "r"(green), [red] "r"(red), [blue] "r"(blue)
+        : [lo] "r"(lo), [hi] "r"(hi), [green] "r"(c.g), [red] "r"(c.r), [blue] "r"(c.b)
         : "r16", "r17");
 }
 
@@ -5,6 +5,7 @@
 #include <avr/io.h>			//					//		Attiny13a, Fuses =0xFF7A, CLK=9.6 MHz, Flash=476b, SRAM=42b, EEPROM=0b	//
 #include <avr/pgmspace.h>	//					//											 �����: Dolphin, 25.02.2015 17:00	//
 #include <util/delay.h>		//					////////////////////////////////////////////////////////////////////////////////////////////////
+#include "At13Gamma.h"	// el color sale corregido por gamma8()
 #define	LedMax 14			// ���������� ����������� �� �����																	//
 #define OutBitsConfig 0b11	// ����� ����� ������ PB0, PB1																		//
 register volatile uint8_t	LED_Byte		asm("r4"),		LED_Mask_Off	asm("r6"),	LED_Mask_On		asm("r8"),			//
@@ -20,7 +21,7 @@ c_RGB LEDBuf[LedMax]={{0,0,0},{0,0,0},{0,0,0},{0,0,0},{0,0,0},{0,0,0},{0,0,0},	/
 void inline LED_Out(uint8_t* LED_Data)											//	     ������� �������� ������ WS2811			//
 {																				//	� ���������� - ��������� �� ��������� GRB	//
 	for (uint8_t Byte_Pos=0; Byte_Pos<3; Byte_Pos++){				 //////////////////    ( 48 ���� ���� ) (30 ���)     /////////////////////
-		LED_Byte=*LED_Data++;										//														//
+		LED_Byte=gamma8(*LED_Data++);										//														//
 		asm volatile(	"	ldi   R16,8		\n\t"					//				             Connection notes:					//
 						"NxtBit:			\n\t"					//														//
 						"	out   0x18,R8	\n\t"	//  PB <- 1  		//				(PB0) 									//
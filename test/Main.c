@@ -39,6 +39,7 @@
 #include <avr/io.h>
 #include <inttypes.h>
 #include <util/delay.h>
+#include "At13Gamma.h"
 
 #define F_CPU 9600000
 #define BUZZER _BV(PINB0)
@@ -149,6 +150,7 @@ void ws2812b_change_color()
   const uint8_t portb = PORTB; // PORTB is volatile, so preload value
   const uint8_t lo = portb & ~LED;
   const uint8_t hi = portb | LED;
+  const gamma_grb_t c = gamma_grb(r, g, b); // el LED recibe el color ya corregido (ver At13Gamma.h)
   __asm__ volatile(
       // Each 12 cycles go high on cycle 0 and go low on cycle:
       //   - 8 if a one bit is transmitted
@@ -294,7 +296,7 @@ void ws2812b_change_color()
       ".end:                          \n\t"
 
       : // No outputs
-      : [lo] "r"(lo), [hi] "r"(hi), [green] "r"(g), [red] "r"(r), [blue] "r"(b)
+      : [lo] "r"(lo), [hi] "r"(hi), [green] "r"(c.g), [red] "r"(c.r), [blue] "r"(c.b)
       : "r16", "r17");
 
   PORTB &= ~LED; // RESET
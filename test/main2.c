@@ -2,6 +2,7 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <util/delay.h>
+#include "At13Gamma.h"
 
 #define F_CPU 9600000
 #define BUZZER _BV(PINB0)
@@ -38,6 +39,7 @@ void ws2812b_change_color()
     const uint8_t portb = PORTB; // PORTB is volatile, so preload value
     const uint8_t lo = portb & ~LED;
     const uint8_t hi = portb | LED;
+    const gamma_grb_t c = gamma_grb(r, g, b); // el LED recibe el color ya corregido (ver At13Gamma.h)
     __asm__ volatile(
         // Each 12 cycles go high on cycle 0 and go low on cycle:
         //   - 8 if a one bit is transmitted
@@ -183,7 +185,7 @@ void ws2812b_change_color()
         ".end:                          \n\t"
 
         : // No outputs
-        : [lo] "r"(lo), [hi] "r"(hi), [green] "r"(g), [red] "r"(r), [blue] "r"(b)
+        : [lo] "r"(lo), [hi] "r"(hi), [green] "r"(c.g), [red] "r"(c.r), [blue] "r"(c.b)
         : "r16", "r17");
 
     PORTB &= ~LED; // RESET
@@ -226,7 +228,9 @@ enum
 #define BUZZER_OFF PORTB &= ~BUZZER;
 
 // primera posicion - 0°, ultima posicion - 180°
-uint16_t servo_microseconds[] = {590, 768, 946, 1124, 1302, 1480, 1658, 1836, 2014, 2192, 2370, 2548, 2730UL};
+#define SERVO_US_MIN 590
+#include "At13ServoCal.h"
+const uint16_t servo_microseconds[] PROGMEM = SERVO_TABLA(SERVO_US);
 uint16_t servo_position; // registro para posicionar el servo
 
 void mover_servo(uint8_t index)
@@ -236,7 +240,7 @@ void mover_servo(uint8_t index)
         return;
     index_ant = index;
 
-    servo_position = servo_microseconds[index];
+    servo_position = pgm_read_word(&servo_microseconds[index]);
     for (uint8_t i = 0; i < 30; i++)
     {
         PORTB |= SERVO;